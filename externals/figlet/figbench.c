@@ -0,0 +1,458 @@
+/****************************************************************************
+
+  FIGlet Copyright 1991, 1993, 1994 Glenn Chappell and Ian Chai
+  FIGlet Copyright 1996, 1997, 1998, 1999, 2000, 2001 John Cowan
+  FIGlet Copyright 2002 Christiaan Keet
+  FIGlet Copyright 2011, 2012 Claudio Matsuoka
+  Portions written by Paul Burton and Christiaan Keet
+  Internet: <info@figlet.org>
+  FIGlet, along with the various FIGlet fonts and documentation, is
+    copyrighted under the provisions of the New BSD License (3-clause)
+    (as listed in the file "LICENSE" which is included in this package)
+****************************************************************************/
+
+/*
+ * figbench - times libfiglet
+ *
+ * Usage: figbench [ -d fontdir ] [ -f fontfile ] [ -m smushmode ]
+ *                 [ -w outputwidth ] [ -C controlfile ] [ -n count ]
+ *                 [ -r repeat ] [ -pRU ] [ file ]
+ *        figbench -l [ -d fontdir ] [ -n count ] [ -c cachedir | -L ]
+ *                 font ...
+ *        figbench -z [ -n count ] zipfile ...
+ *
+ * Reads file (or standard input) into memory, repeat times over, and
+ * renders it count times, discarding the output.  -p, -R and -C are as
+ * for figlet.  With -U, only decodes it as UTF-8 instead.  Prints the
+ * CPU time taken and the input and output rates.
+ *
+ * With -l, loads each of the fonts count times instead, lazily with -L
+ * or through the font cache cachedir with -c, and prints the time per
+ * font load and the rate in font file bytes.
+ *
+ * With -z, reads each zip file count times through zipio instead,
+ * streamed, and prints the rates of inflating it in zipped and in
+ * unzipped bytes.
+ * Not installed; "make bench" runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "figlet.h"
+#include "utf8.h"
+#include "zipio.h"
+
+static const char *myname = "figbench";
+static size_t outbytes;
+
+
+/****************************************************************************
+
+  usage
+
+****************************************************************************/
+
+static void usage(void)
+{
+  fprintf(stderr,"Usage: %s [ -d fontdir ] [ -f fontfile ] [ -m smushmode ]\n"
+    "                [ -w outputwidth ] [ -C controlfile ] [ -n count ]\n"
+    "                [ -r repeat ] [ -pRU ] [ file ]\n"
+    "       %s -l [ -d fontdir ] [ -n count ] [ -c cachedir | -L ]\n"
+    "                font ...\n"
+    "       %s -z [ -n count ] zipfile ...\n",
+    myname,myname,myname);
+  exit(1);
+}
+
+
+/****************************************************************************
+
+  readinput
+
+  Reads all of the given stream into memory, repeat times over.
+
+****************************************************************************/
+
+static char *readinput(FILE *fp, int repeat, size_t *lenp)
+{
+  char *buf = NULL;
+  size_t len = 0, size = 0, n;
+  int i;
+
+  do {
+    if (len==size) {
+      size = size ? size*2 : 65536;
+      buf = (char*)realloc(buf,size);
+      if (buf==NULL) {
+        fprintf(stderr,"%s: Out of memory\n",myname);
+        exit(1);
+        }
+      }
+    n = fread(buf+len,1,size-len,fp);
+    len += n;
+    } while (n>0);
+  if (repeat>1) {
+    buf = (char*)realloc(buf,len*repeat+1);
+    if (buf==NULL) {
+      fprintf(stderr,"%s: Out of memory\n",myname);
+      exit(1);
+      }
+    for (i=1;i<repeat;i++) {
+      memcpy(buf+len*i,buf,len);
+      }
+    len *= repeat;
+    }
+  *lenp = len;
+  return buf;
+}
+
+
+/****************************************************************************
+
+  discard
+
+  Output callback that only counts what it is given.
+
+****************************************************************************/
+
+static int discard(void *userdata, const char *buf, size_t len)
+{
+  outbytes += len;
+  return 0;
+}
+
+
+/****************************************************************************
+
+  rate
+
+  Returns bytes per second in MB/s.
+
+****************************************************************************/
+
+static double rate(double bytes, double secs)
+{
+  return secs>0 ? bytes/secs/1e6 : 0;
+}
+
+
+/****************************************************************************
+
+  decode
+
+  Decodes all of the input as UTF-8, skipping over what is not valid.
+  Returns the number of chars.
+
+****************************************************************************/
+
+static size_t decode(const char *input, size_t len)
+{
+  static utf8_cp_t buf[4096];
+  const unsigned char *p,*end;
+  size_t chars,n;
+
+  chars = 0;
+  p = (const unsigned char*)input;
+  end = p+len;
+  while (p<end) {
+    n = utf8_decode(&p,end,buf,sizeof(buf)/sizeof(buf[0]));
+    if (n==0) {
+      p++;
+      }
+    chars += n;
+    }
+  return chars;
+}
+
+
+/****************************************************************************
+
+  fontsize
+
+  Returns the size of the file the named font is loaded from, or 0 if
+  it cannot be found.  Fonts are looked up the way figlet does, with or
+  without a .flf or .tlf suffix, in fontdir unless the name has a path.
+
+****************************************************************************/
+
+static long fontsize(const char *fontdir, const char *fontname)
+{
+  static const char *suffixes[] = {"", ".flf", ".tlf"};
+  char *path;
+  FILE *fp;
+  long size;
+  int i;
+
+  path = (char*)malloc(strlen(fontdir)+strlen(fontname)+6);
+  if (path==NULL) return 0;
+  size = 0;
+  for (i=0;i<3 && size==0;i++) {
+    if (strchr(fontname,'/')!=NULL) {
+      sprintf(path,"%s%s",fontname,suffixes[i]);
+      }
+    else {
+      sprintf(path,"%s/%s%s",fontdir,fontname,suffixes[i]);
+      }
+    if ((fp = fopen(path,"rb"))==NULL) continue;
+    if (fseek(fp,0L,SEEK_END)==0) size = ftell(fp);
+    fclose(fp);
+    if (size<0) size = 0;
+    }
+  free(path);
+  return size;
+}
+
+
+/****************************************************************************
+
+  loadfonts
+
+  Loads each of the named fonts count times and prints how long that
+  took, per font and in MB/s of font file.
+
+****************************************************************************/
+
+static void loadfonts(const char *fontdir, char **names, int nnames,
+  int count, int lazy, const char *cachedir)
+{
+  figlet_font *font;
+  clock_t start;
+  double secs,bytes;
+  int i,j,err;
+  char *name,*dot;
+
+  secs = bytes = 0;
+  for (i=0;i<nnames;i++) {
+    name = (char*)malloc(strlen(names[i])+1);
+    if (name==NULL) {
+      fprintf(stderr,"%s: Out of memory\n",myname);
+      exit(1);
+      }
+    strcpy(name,names[i]);
+    dot = strrchr(name,'.');
+    if (dot!=NULL && (!strcmp(dot,".flf") || !strcmp(dot,".tlf"))) {
+      *dot = '\0';
+      }
+    bytes += (double)fontsize(fontdir,name)*count;
+    start = clock();
+    for (j=0;j<count;j++) {
+      if (cachedir!=NULL) {
+        font = figlet_font_load_cached(fontdir,name,cachedir,&err);
+        }
+      else if (lazy) {
+        font = figlet_font_load_lazy(fontdir,name,&err);
+        }
+      else {
+        font = figlet_font_load(fontdir,name,&err);
+        }
+      if (font==NULL) {
+        fprintf(stderr,"%s: %s: %s\n",myname,name,figlet_strerror(err));
+        exit(1);
+        }
+      figlet_font_unref(font);
+      }
+    secs += (double)(clock()-start)/CLOCKS_PER_SEC;
+    free(name);
+    }
+  printf("%s load: %d fonts x %d: %.3f s, %.3f ms/font, %.2f MB/s\n",
+    cachedir!=NULL ? "cached" : lazy ? "lazy" : "eager",nnames,count,secs,
+    nnames>0 && count>0 ? secs*1e3/nnames/count : 0,rate(bytes,secs));
+}
+
+
+/****************************************************************************
+
+  unzipfiles
+
+  Reads each of the named zip files count times, streamed, and prints
+  how long that took, in MB/s of zip file and of what it unzips to.
+
+****************************************************************************/
+
+static void unzipfiles(char **names, int nnames, int count)
+{
+  static char buf[65536];
+  ZFILE *zfp;
+  FILE *fp;
+  clock_t start;
+  double secs,inbytes,unzipped;
+  size_t n;
+  int i,j;
+
+  secs = inbytes = unzipped = 0;
+  for (i=0;i<nnames;i++) {
+    if ((fp = fopen(names[i],"rb"))==NULL) {
+      fprintf(stderr,"%s: %s: Unable to open file\n",myname,names[i]);
+      exit(1);
+      }
+    if (fseek(fp,0L,SEEK_END)==0) inbytes += (double)ftell(fp)*count;
+    fclose(fp);
+    start = clock();
+    for (j=0;j<count;j++) {
+      if ((zfp = Zopen(names[i],"rbs"))==NULL) {
+        fprintf(stderr,"%s: %s: Unable to open file\n",myname,names[i]);
+        exit(1);
+        }
+      while ((n = Zread(buf,1,sizeof(buf),zfp))>0) {
+        unzipped += n;
+        }
+      Zclose(zfp);
+      }
+    secs += (double)(clock()-start)/CLOCKS_PER_SEC;
+    }
+  printf("unzip: %d files x %d: %.3f s, %.2f MB/s in, %.2f MB/s out\n",
+    nnames,count,secs,rate(inbytes,secs),rate(unzipped,secs));
+}
+
+
+int main(int argc, char *argv[])
+{
+  const char *fontdir = "fonts";
+  const char *fontname = "standard";
+  const char *controlname = NULL;
+  const char *cachedir = NULL;
+  figlet_options opts;
+  figlet_context *ctx;
+  FILE *fp;
+  char *input;
+  size_t len;
+  int i,count,repeat,err,decodeonly,loadonly,lazy,unziponly;
+  size_t chars;
+  clock_t start;
+  double secs;
+
+  figlet_defaults(&opts);
+  count = 10;
+  repeat = 1;
+  decodeonly = 0;
+  loadonly = 0;
+  lazy = 0;
+  unziponly = 0;
+  for (i=1;i<argc && argv[i][0]=='-' && argv[i][1]!='\0';i++) {
+    switch (argv[i][1]) {
+      case 'R':
+        opts.right2left = 1;
+        continue;
+      case 'p':
+        opts.paragraphflag = 1;
+        continue;
+      case 'U':
+        decodeonly = 1;
+        continue;
+      case 'l':
+        loadonly = 1;
+        continue;
+      case 'L':
+        lazy = 1;
+        continue;
+      case 'z':
+        unziponly = 1;
+        continue;
+      case 'd': case 'f': case 'm': case 'w': case 'n': case 'r': case 'C':
+      case 'c':
+        if (argv[i][2]!='\0' || i+1>=argc) usage();
+        break;
+      default:
+        usage();
+      }
+    switch (argv[i++][1]) {
+      case 'd':
+        fontdir = argv[i];
+        break;
+      case 'f':
+        fontname = argv[i];
+        break;
+      case 'm':
+        opts.smushmode = atoi(argv[i]);
+        if (opts.smushmode < -1) {
+          opts.smushoverride = SMO_NO;
+          break;
+          }
+        if (opts.smushmode == 0) opts.smushmode = SM_KERN;
+        else if (opts.smushmode == -1) opts.smushmode = 0;
+        else opts.smushmode = (opts.smushmode & 63) | SM_SMUSH;
+        opts.smushoverride = SMO_YES;
+        break;
+      case 'w':
+        opts.outputwidth = atoi(argv[i]);
+        break;
+      case 'n':
+        count = atoi(argv[i]);
+        break;
+      case 'r':
+        repeat = atoi(argv[i]);
+        break;
+      case 'C':
+        controlname = argv[i];
+        break;
+      case 'c':
+        cachedir = argv[i];
+        break;
+      }
+    }
+  if (loadonly) {
+    if (i>=argc) usage();
+    loadfonts(fontdir,argv+i,argc-i,count,lazy,cachedir);
+    return 0;
+    }
+  if (unziponly) {
+    if (i>=argc) usage();
+    unzipfiles(argv+i,argc-i,count);
+    return 0;
+    }
+  if (i+1<argc) usage();
+  if (i<argc) {
+    if ((fp = fopen(argv[i],"rb"))==NULL) {
+      fprintf(stderr,"%s: %s: Unable to open file\n",myname,argv[i]);
+      exit(1);
+      }
+    }
+  else {
+    fp = stdin;
+    }
+  input = readinput(fp,repeat,&len);
+  if (fp!=stdin) fclose(fp);
+
+  if (decodeonly) {
+    chars = 0;
+    start = clock();
+    for (i=0;i<count;i++) {
+      chars += decode(input,len);
+      }
+    secs = (double)(clock()-start)/CLOCKS_PER_SEC;
+    printf("utf8 decode: %lu bytes x %d: %.3f s, %.2f MB/s in, %lu chars\n",
+      (unsigned long)len,count,secs,rate((double)len*count,secs),
+      (unsigned long)(chars/count));
+    free(input);
+    return 0;
+    }
+
+  ctx = figlet_new(&opts);
+  if (controlname!=NULL &&
+      (err = figlet_read_control(ctx,fontdir,controlname))!=FIGLET_OK) {
+    fprintf(stderr,"%s: %s: %s\n",myname,controlname,figlet_strerror(err));
+    exit(1);
+    }
+  if ((err = figlet_load_font(ctx,fontdir,fontname))!=FIGLET_OK) {
+    fprintf(stderr,"%s: %s: %s\n",myname,fontname,figlet_strerror(err));
+    exit(1);
+    }
+
+  outbytes = 0;
+  start = clock();
+  for (i=0;i<count;i++) {
+    figlet_render(ctx,input,len,discard);
+    }
+  secs = (double)(clock()-start)/CLOCKS_PER_SEC;
+
+  printf("render %s: %lu bytes x %d: %.3f s, %.2f MB/s in, %.2f MB/s out\n",
+    fontname,(unsigned long)len,count,secs,
+    rate((double)len*count,secs),rate((double)outbytes,secs));
+
+  figlet_free(ctx);
+  free(input);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/****************************************************************************
+
+  FIGlet Copyright 1991, 1993, 1994 Glenn Chappell and Ian Chai
+  FIGlet Copyright 1996, 1997, 1998, 1999, 2000, 2001 John Cowan
+  FIGlet Copyright 2002 Christiaan Keet
+  FIGlet Copyright 2011, 2012 Claudio Matsuoka
+  Portions written by Paul Burton and Christiaan Keet
+  Internet: <info@figlet.org>
+  FIGlet, along with the various FIGlet fonts and documentation, is
+    copyrighted under the provisions of the New BSD License (3-clause)
+    (as listed in the file "LICENSE" which is included in this package)
+****************************************************************************/
+
+/*
+ * figc - compiles FIGlet fonts
+ *
+ * Usage: figc [ -d fontdir ] [ -o outfile ] fontname ...
+ *
+ * Reads each font and writes it out as a compiled font (.flb) next to
+ * the font file, or to outfile if there is just one font.  libfiglet
+ * loads a compiled font by mapping it into memory, in place of
+ * reading and parsing the font file, for as long as the font file is
+ * unchanged.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "figint.h"
+
+#ifndef DEFAULTFONTDIR
+#define DEFAULTFONTDIR "fonts"
+#endif
+
+static const char *myname = "figc";
+
+
+/****************************************************************************
+
+  usage
+
+****************************************************************************/
+
+static void usage(void)
+{
+  fprintf(stderr,"Usage: %s [ -d fontdir ] [ -o outfile ] fontname ...\n",
+    myname);
+  exit(1);
+}
+
+
+/****************************************************************************
+
+  flbpath
+
+  Returns the name (Alloc'd) of the compiled font for a font file:
+  the font file's name with its suffix replaced, or NULL if there is
+  no memory.
+
+****************************************************************************/
+
+static char *flbpath(const char *path)
+{
+  char *name;
+  const char *dot,*slash;
+  int len;
+
+  dot = strrchr(path,'.');
+  slash = strrchr(path,'/');
+  len = (dot!=NULL && (slash==NULL || dot>slash)) ? dot-path : MYSTRLEN(path);
+  if ((name = figalloc(len+MYSTRLEN(FLBSUFFIX)+1))==NULL) {
+    return NULL;
+    }
+  memcpy(name,path,len);
+  strcpy(name+len,FLBSUFFIX);
+  return name;
+}
+
+
+int main(int argc, char *argv[])
+{
+  const char *fontdir = DEFAULTFONTDIR;
+  const char *outfile = NULL;
+  figlet_font *font;
+  char *path;
+  int i,err,status;
+
+  for (i=1;i<argc && argv[i][0]=='-' && argv[i][1]!='\0';i++) {
+    if (argv[i][2]!='\0' || i+1>=argc) usage();
+    switch (argv[i++][1]) {
+      case 'd':
+        fontdir = argv[i];
+        break;
+      case 'o':
+        outfile = argv[i];
+        break;
+      default:
+        usage();
+      }
+    }
+  if (i>=argc || (outfile!=NULL && i+1<argc)) usage();
+
+  status = 0;
+  for (;i<argc;i++) {
+    if ((font = figfontload(fontdir,argv[i],0,0,NULL,&err))==NULL) {
+      fprintf(stderr,"%s: %s: %s\n",myname,argv[i],figlet_strerror(err));
+      status = 1;
+      continue;
+      }
+    path = outfile!=NULL ? (char*)outfile : flbpath(font->path);
+    if (path==NULL) {
+      fprintf(stderr,"%s: %s: %s\n",myname,argv[i],
+        figlet_strerror(FIGLET_ENOMEM));
+      status = 1;
+      }
+    else if (figflbwrite(font,path)!=0) {
+      fprintf(stderr,"%s: %s: %s\n",myname,path,strerror(errno));
+      status = 1;
+      }
+    if (path!=outfile) free(path);
+    figlet_font_unref(font);
+    }
+  return status;
+}
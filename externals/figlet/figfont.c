@@ -0,0 +1,2095 @@
+/****************************************************************************
+
+  FIGlet Copyright 1991, 1993, 1994 Glenn Chappell and Ian Chai
+  FIGlet Copyright 1996, 1997, 1998, 1999, 2000, 2001 John Cowan
+  FIGlet Copyright 2002 Christiaan Keet
+  FIGlet Copyright 2011, 2012 Claudio Matsuoka
+  Portions written by Paul Burton and Christiaan Keet
+  Internet: <info@figlet.org>
+  FIGlet, along with the various FIGlet fonts and documentation, is
+    copyrighted under the provisions of the New BSD License (3-clause)
+    (as listed in the file "LICENSE" which is included in this package)
+****************************************************************************/
+
+/*
+ * figfont.c - loading of FIGlet fonts
+ *
+ * A font is loaded once into a figlet_font, which is immutable and
+ * reference counted, and is then shared by all contexts rendering
+ * with it.  Nothing a context does while rendering changes the font.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "figint.h"
+
+#ifdef FIG_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef TLF_FONTS
+#include "utf8.h"
+#endif
+
+#define DIRSEP '/'
+#define DIRSEP2 '\\'
+/* Leave alone for Unix and MS-DOS/Windows! */
+
+/* Reference count updates must be atomic, fonts are shared by threads */
+#if defined(__GNUC__)
+#define REFINC(x) __sync_add_and_fetch(&(x),1)
+#define REFDEC(x) __sync_sub_and_fetch(&(x),1)
+#else
+#define REFINC(x) (++(x))
+#define REFDEC(x) (--(x))
+#endif
+
+/* Glyphs of a lazily loaded font are published once, for all threads: */
+/* GLYPHSET sets slot x to g if it is still NULL, and is true if it was */
+#if defined(__GNUC__)
+#define GLYPHSET(x,g) __sync_bool_compare_and_swap(&(x),(figglyph*)NULL,(g))
+#else
+#define GLYPHSET(x,g) ((x)==NULL ? ((x) = (g), 1) : 0)
+#endif
+#if defined(__ATOMIC_ACQUIRE)
+#define GLYPHGET(x) __atomic_load_n(&(x),__ATOMIC_ACQUIRE)
+#else
+#define GLYPHGET(x) (x)
+#endif
+
+/* Archives used as font directories are kept on a list, which threads */
+/* change under a lock: ARCLOCK takes it, spinning, and ARCUNLOCK frees it */
+#if defined(__GNUC__)
+#define ARCLOCK(x) while (__sync_lock_test_and_set(&(x),1)) ;
+#define ARCUNLOCK(x) __sync_lock_release(&(x))
+#else
+#define ARCLOCK(x)
+#define ARCUNLOCK(x)
+#endif
+
+/* Nanoseconds of a file's mtime, where struct stat has them */
+#if defined(__APPLE__)
+#define MTIMENSEC(st) ((long)(st).st_mtimespec.tv_nsec)
+#elif defined(FIG_MMAP)
+#define MTIMENSEC(st) ((long)(st).st_mtim.tv_nsec)
+#else
+#define MTIMENSEC(st) 0L
+#endif
+
+const inchr deutsch[7] = {196, 214, 220, 228, 246, 252, 223};
+  /* Latin-1 codes for German letters, respectively:
+     LATIN CAPITAL LETTER A WITH DIAERESIS = A-umlaut
+     LATIN CAPITAL LETTER O WITH DIAERESIS = O-umlaut
+     LATIN CAPITAL LETTER U WITH DIAERESIS = U-umlaut
+     LATIN SMALL LETTER A WITH DIAERESIS = a-umlaut
+     LATIN SMALL LETTER O WITH DIAERESIS = o-umlaut
+     LATIN SMALL LETTER U WITH DIAERESIS = u-umlaut
+     LATIN SMALL LETTER SHARP S = ess-zed
+  */
+
+
+/****************************************************************************
+
+  figalloc
+
+  Calls malloc.  Returns NULL if there is no memory, which the caller
+  passes back up as FIGLET_ENOMEM: the library never exits.
+
+****************************************************************************/
+
+char *figalloc(size_t size)
+{
+  return (char*)malloc(size);
+}
+
+
+/****************************************************************************
+
+  hasdirsep
+
+  Returns true if s1 contains a DIRSEP or DIRSEP2 character.
+
+****************************************************************************/
+
+static int hasdirsep(const char *s1)
+{
+  if (strchr(s1, DIRSEP)) return 1;
+  else if (strchr(s1, DIRSEP2)) return 1;
+  else return 0;
+}
+
+
+/****************************************************************************
+
+  figskiptoeol
+
+  Skips to the end of a line, given a stream.  Handles \r, \n, or \r\n.
+
+****************************************************************************/
+
+void figskiptoeol(ZFILE *fp)
+{
+  int dummy;
+
+  while (dummy=Zgetc(fp),dummy!=EOF) {
+    if (dummy == '\n') return;
+    if (dummy == '\r') {
+      dummy = Zgetc(fp);
+      if (dummy != EOF && dummy != '\n') Zungetc(dummy,fp);
+      return;
+      }
+  }
+}
+
+
+/****************************************************************************
+
+  fonttext
+
+  A font file held in memory while it is read: the bytes not read yet
+  are p to end.  Font files are read whole, and their lines found with
+  memchr, rather than a byte at a time from the stream.
+
+****************************************************************************/
+
+typedef struct {
+  const char *p;
+  const char *end;
+  } fonttext;
+
+/* What textline found */
+#define TEXTEOF 0   /* the end of the file */
+#define TEXTCUT 1   /* a line cut short at maxlen */
+#define TEXTLINE 2  /* a whole line */
+
+
+/****************************************************************************
+
+  textline
+
+  Finds the next line of a font file in memory, and steps past it.
+  Sets *linep and *lenp to its bytes, without the line end, which may
+  be \r, \n, or \r\n.  A line longer than maxlen is cut short there,
+  and the byte after dropped, as FIGlet has always read font files.
+  Returns TEXTEOF if the file ends before the line does (so its last
+  line counts only if it is ended), else TEXTCUT or TEXTLINE.
+
+****************************************************************************/
+
+static int textline(fonttext *t, int maxlen, const char **linep, int *lenp)
+{
+  const char *s,*e,*r;
+  int n;
+
+  s = t->p;
+  n = t->end-s>maxlen ? maxlen : (int)(t->end-s);
+  *linep = s;
+  e = (const char*)memchr(s,'\n',n);
+  if ((r = (const char*)memchr(s,'\r',e!=NULL ? e-s : n))!=NULL) {
+    e = r;
+    }
+  if (e==NULL) {
+    *lenp = n;
+    if (t->end-s<=maxlen) {
+      t->p = t->end;
+      return TEXTEOF;
+      }
+    t->p = s+n+1;
+    return TEXTCUT;
+    }
+  *lenp = e-s;
+  t->p = e+1;
+  if (*e=='\r') {
+    if (t->p>=t->end) return TEXTEOF;
+    if (*t->p=='\n') t->p++;
+    }
+  return TEXTLINE;
+}
+
+
+/****************************************************************************
+
+  textgets
+
+  Reads a line of a font file in memory into line, as a string ending
+  in \n if the line was ended, the way fgets does.  line has room for
+  maxlen+1 chars.  Returns 0 if the file ends before the line does.
+
+****************************************************************************/
+
+static int textgets(fonttext *t, char *line, int maxlen)
+{
+  const char *s;
+  int n,found;
+
+  found = textline(t,maxlen,&s,&n);
+  memcpy(line,s,n);
+  if (found==TEXTLINE) {
+    line[n++] = '\n';
+    }
+  line[n] = '\0';
+  return found!=TEXTEOF;
+}
+
+
+/****************************************************************************
+
+  textskiptoeol
+
+  Skips to the end of a line of a font file in memory.
+
+****************************************************************************/
+
+static void textskiptoeol(fonttext *t)
+{
+  int c;
+
+  while (t->p<t->end) {
+    c = *t->p++;
+    if (c=='\n') return;
+    if (c=='\r') {
+      if (t->p<t->end && *t->p=='\n') t->p++;
+      return;
+      }
+    }
+}
+
+
+/****************************************************************************
+
+  textmagic
+
+  Reads the four-character magic string of a font file in memory.
+
+****************************************************************************/
+
+static void textmagic(fonttext *t, char *magic)
+{
+  int i;
+
+  for (i=0;i<4;i++) {
+    magic[i] = t->p<t->end ? *t->p++ : EOF;
+    }
+  magic[4] = 0;
+}
+
+
+/****************************************************************************
+
+  figarc
+
+  Zip archives used as font directories (as in "-d fonts.zip") are
+  kept on a list, each opened, read and indexed once and then shared
+  by all threads.  The list is changed and read under archivelock.
+
+****************************************************************************/
+
+typedef struct figarc {
+  struct figarc *next;
+  char *path;             /* as given as the font directory */
+  struct stat st;         /* of the archive when it was opened */
+  ZARCHIVE *archive;
+  } figarc;
+
+static figarc *archives = NULL;
+static volatile int archivelock = 0;
+
+
+/****************************************************************************
+
+  figarcfind
+
+  Returns the link to the entry for path on the list of archives, or
+  NULL if there is none.  The list must be locked.
+
+****************************************************************************/
+
+static figarc **figarcfind(const char *path)
+{
+  figarc **ap;
+
+  for (ap=&archives;*ap!=NULL;ap=&(*ap)->next) {
+    if (!strcmp((*ap)->path,path)) return ap;
+    }
+  return NULL;
+}
+
+
+/****************************************************************************
+
+  figarcsame
+
+  Returns true if the archive of an entry was opened from the file st
+  is of, as it is now: the same file, of the same size, and not
+  written since, to the nanosecond where the mtime has them.
+
+****************************************************************************/
+
+static int figarcsame(const figarc *a, const struct stat *st)
+{
+  return a->st.st_dev==st->st_dev && a->st.st_ino==st->st_ino &&
+    a->st.st_size==st->st_size && a->st.st_mtime==st->st_mtime &&
+    MTIMENSEC(a->st)==MTIMENSEC(*st);
+}
+
+
+/****************************************************************************
+
+  figarchive
+
+  Given a font directory that is a zip archive of font and control
+  files, returns its entry on the list of archives, with the list
+  locked, or NULL (and the list unlocked) if it is not one.  The
+  archive is checked against the file on each lookup, and opened
+  again if the file has changed.  The new one replaces the old on the
+  list, and the old is closed, which releases it as soon as no file
+  opened from it is still open.
+
+****************************************************************************/
+
+static figarc *figarchive(const char *fontdir)
+{
+  figarc *a,*old,**ap;
+  struct stat st;
+  ZARCHIVE *archive;
+
+  if (stat(fontdir,&st)!=0 || !S_ISREG(st.st_mode)) return NULL;
+  ARCLOCK(archivelock);
+  if ((ap = figarcfind(fontdir))!=NULL && figarcsame(*ap,&st)) return *ap;
+  ARCUNLOCK(archivelock);
+
+  /* Opened without the lock, as it reads all of the archive */
+  if ((archive = Zarchive_open(fontdir))==NULL) return NULL;
+  if ((a = (figarc*)figalloc(sizeof(figarc)))==NULL ||
+      (a->path = (char*)figalloc(MYSTRLEN(fontdir)+1))==NULL) {
+    free(a);
+    Zarchive_close(archive);
+    return NULL;
+    }
+  strcpy(a->path,fontdir);
+  a->st = st;
+  a->archive = archive;
+
+  ARCLOCK(archivelock);
+  if ((ap = figarcfind(fontdir))!=NULL) {  /* stale, or opened meanwhile */
+    old = *ap;
+    *ap = old->next;
+    Zarchive_close(old->archive);
+    free(old->path);
+    free(old);
+    }
+  a->next = archives;
+  archives = a;
+  return a;
+}
+
+
+/****************************************************************************
+
+  figmember
+
+  If path is of a file in an archive on the list of archives (the font
+  directory, DIRSEP, and the file's name), returns the archive's entry
+  and sets *namep to the file's name.  Otherwise returns NULL.  The
+  list must be locked.
+
+****************************************************************************/
+
+static figarc *figmember(const char *path, const char **namep)
+{
+  figarc *a;
+  int len;
+
+  for (a=archives;a!=NULL;a=a->next) {
+    len = MYSTRLEN(a->path);
+    if (!strncmp(path,a->path,len) && path[len]==DIRSEP) {
+      *namep = path+len+1;
+      return a;
+      }
+    }
+  return NULL;
+}
+
+
+/****************************************************************************
+
+  figzopen
+
+  Opens a font or control file found by figfindfile, from its archive
+  if it is in one.  Either way it is streamed, as it is read only once.
+  A file opened from an archive holds it till the file is closed.
+
+****************************************************************************/
+
+static ZFILE *figzopen(const char *path)
+{
+  figarc *a;
+  const char *name;
+  ZFILE *fp;
+
+  ARCLOCK(archivelock);
+  if ((a = figmember(path,&name))!=NULL) {
+    fp = Zopen_member(a->archive,name,"rbs");
+    ARCUNLOCK(archivelock);
+    return fp;
+    }
+  ARCUNLOCK(archivelock);
+  return Zopen(path,"rbs");
+}
+
+
+/****************************************************************************
+
+  figfindfile
+
+  Given a FIGlet font or control file name and suffix, returns the
+  path of the file (Alloc'd) or NULL if not found, or with errno set
+  to ENOMEM if there is no memory.  If the font directory is a zip
+  archive, the path is of the file in it.
+
+****************************************************************************/
+
+char *figfindfile(const char *fontdir, const char *name, const char *suffix)
+{
+  char *fontpath;
+  struct stat st;
+  figarc *a;
+  int namelen,found;
+
+  namelen = MYSTRLEN(fontdir);
+  fontpath = figalloc(sizeof(char)*
+    (namelen+MYSTRLEN(name)+MYSTRLEN(suffix)+2));
+  if (fontpath==NULL) {
+    errno = ENOMEM;
+    return NULL;
+    }
+  if (!hasdirsep(name)) {  /* not a full path name */
+    strcpy(fontpath,fontdir);
+    fontpath[namelen] = DIRSEP;
+    fontpath[namelen+1] = '\0';
+    strcat(fontpath,name);
+    strcat(fontpath,suffix);
+    if(stat(fontpath,&st)==0) return fontpath;
+    if((a = figarchive(fontdir))!=NULL) {
+      found = Zmember_size(a->archive,fontpath+namelen+1)>=0;
+      ARCUNLOCK(archivelock);
+      if (found) return fontpath;
+      }
+    else if (errno==ENOMEM) {  /* no memory to open the archive */
+      free(fontpath);
+      return NULL;
+      }
+    }
+  /* just append suffix */
+  strcpy(fontpath,name);
+  strcat(fontpath,suffix);
+  if(stat(fontpath,&st)==0) return fontpath;
+
+  free(fontpath);
+  return NULL;
+}
+
+
+/****************************************************************************
+
+  FIGopen
+
+  Given a FIGlet font or control file name and suffix, return the file
+  or NULL if not found, with errno set as figfindfile does
+
+****************************************************************************/
+
+ZFILE *FIGopen(const char *fontdir, const char *name, const char *suffix)
+{
+  char *fontpath;
+  ZFILE *fontfile;
+
+  if ((fontpath = figfindfile(fontdir,name,suffix))==NULL) {
+    return NULL;
+    }
+  fontfile = figzopen(fontpath);
+  free(fontpath);
+  return fontfile;
+}
+
+
+/****************************************************************************
+
+  fontbuild
+
+  The tables of a font while its font file is read: rows are added
+  to the end of growing arrays, always as outchr, in the order they
+  are read.  packfont turns them into the font's own.
+
+****************************************************************************/
+
+typedef struct {
+  fcharinfo *chars;  /* in the order read */
+  int nchars,maxchars;
+  fcedge *edges;
+  int *rowoff;       /* where each row starts in cells */
+  int nrows,maxrows;
+  outchr *cells;
+  int ncells,maxcells;
+  } fontbuild;
+
+
+/****************************************************************************
+
+  figgrow
+
+  Makes room in an array of *maxp elements of the given size for at
+  least need elements, reallocating and updating *maxp if necessary.
+  If there is no memory, frees the array and returns NULL.
+
+****************************************************************************/
+
+static void *figgrow(void *array, int *maxp, int need, size_t size)
+{
+  void *grown;
+  int max;
+
+  if (need<=*maxp) {
+    return array;
+    }
+  for (max=*maxp>0?*maxp*2:256;max<need;max*=2) ;
+  if ((grown = realloc(array,size*max))==NULL) {
+    free(array);
+    return NULL;
+    }
+  *maxp = max;
+  return grown;
+}
+
+
+/****************************************************************************
+
+  rowedge
+
+  Works out the edge profile of a row of len chars.
+
+****************************************************************************/
+
+static void rowedge(fcedge *edge, const outchr *line, int len)
+{
+  int k;
+
+  edge->len = len;
+  for (k=0;k<len && line[k]==' ';k++) ;
+  edge->left = k;
+  edge->leftch = k<len ? line[k] : '\0';
+  for (k=len-1;k>=0 && line[k]==' ';k--) ;
+  edge->right = k;
+  edge->rightch = len>0 ? line[k>0?k:0] : '\0';
+}
+
+
+/****************************************************************************
+
+  addchar
+
+  Starts a new character in the font being read.  Its rows are the
+  next charheight rows added.  Returns false if there is no memory.
+
+****************************************************************************/
+
+static int addchar(fontbuild *fb, inchr theord)
+{
+  fcharinfo *fc;
+
+  fb->chars = (fcharinfo*)figgrow(fb->chars,&fb->maxchars,fb->nchars+1,
+    sizeof(fcharinfo));
+  if (fb->chars==NULL) {
+    return 0;
+    }
+  fc = &fb->chars[fb->nchars++];
+  fc->ord = (int)theord;
+  fc->row = fb->nrows;
+  fc->width = 0;
+  return 1;
+}
+
+
+/****************************************************************************
+
+  fontrow
+
+  Turns a row of a character, the n bytes at line in the font file,
+  into the row itself in outline, which has room for MAXLEN+1 chars:
+  decodes it, as Latin-1 if it is not UTF-8 (as in older FIGfonts),
+  and removes trailing spaces and the endmarks.  A NUL ends the row.
+  Returns the row's length.
+
+****************************************************************************/
+
+static int fontrow(const char *line, int n, outchr *outline)
+{
+  const char *nul;
+  int k;
+  outchr endchar;
+
+  if ((nul = (const char*)memchr(line,'\0',n))!=NULL) {
+    n = nul-line;
+    }
+#ifdef TLF_FONTS
+  for (k=0;k<n && (line[k]&0x80)==0;k++) {  /* ASCII needs no decoding */
+    outline[k] = line[k];
+    }
+  if (k<n && (k = utf8_to_wchar(line,n,outline,MAXLEN,0))==0) {
+    for (k=0;k<n;k++) {
+      outline[k] = (unsigned char)line[k];
+      }
+    }
+#else
+  memcpy(outline,line,n);
+  k = n;
+#endif
+  k--;
+  while (k>=0 && ISSPACE(outline[k])) {  /* remove trailing spaces */
+    k--;
+    }
+  if (k>=0) {
+    endchar = outline[k];  /* remove endmarks */
+    while (k>=0 && outline[k]==endchar) {
+      k--;
+      }
+    }
+  outline[k+1] = '\0';
+  return k+1;
+}
+
+
+/****************************************************************************
+
+  readrows
+
+  Reads the rows of a character from a font file in memory into cells,
+  which has room for charheight rows of MAXLEN+1 chars, or makes them
+  empty if t is NULL (the "missing" character).  The rows are put one
+  after the other, each NUL-terminated, and where each starts and its
+  edge profile are set in rowoff and edges.  Rows shorter than the
+  widest are padded with blanks to its width, as smushing takes every
+  row of a character to be as wide as the character.  Returns the
+  number of cells used.
+
+****************************************************************************/
+
+static int readrows(const figlet_font *font, fonttext *t, outchr *cells,
+  int *rowoff, fcedge *edges)
+{
+  const char *line;
+  outchr *outline;
+  int row,k,n,len,width;
+
+  width = 0;
+  for (row=0;row<font->charheight;row++) {
+    line = "";
+    n = 0;
+    if (t!=NULL && textline(t,MAXLEN,&line,&n)==TEXTEOF) {
+      n = 0;
+      }
+    len = fontrow(line,n,cells+row*(MAXLEN+1));
+    rowoff[row] = len;  /* for now */
+    if (len>width) {
+      width = len;
+      }
+    }
+  for (row=0;row<font->charheight;row++) {
+    len = rowoff[row];
+    outline = cells+row*(width+1);
+    memmove(outline,cells+row*(MAXLEN+1),sizeof(outchr)*len);
+    for (k=len;k<width;k++) {
+      outline[k] = ' ';
+      }
+    outline[width] = '\0';
+    rowoff[row] = row*(width+1);
+    rowedge(&edges[row],outline,width);
+    }
+  return font->charheight*(width+1);
+}
+
+
+/****************************************************************************
+
+  readfontchar
+
+  Reads a font character from the font file, or the "missing"
+  character if t is NULL, and adds it to the font being read.  Its
+  rows are decoded straight into the font's cells.  Returns false if
+  there is no memory.
+
+****************************************************************************/
+
+static int readfontchar(figlet_font *font, fontbuild *fb, fonttext *t,
+  inchr theord)
+{
+  int row,k,n;
+
+  if (!addchar(fb,theord)) {
+    return 0;
+    }
+  k = fb->maxrows;
+  fb->edges = (fcedge*)figgrow(fb->edges,&k,fb->nrows+font->charheight,
+    sizeof(fcedge));
+  fb->rowoff = (int*)figgrow(fb->rowoff,&fb->maxrows,
+    fb->nrows+font->charheight,sizeof(int));
+  fb->cells = (outchr*)figgrow(fb->cells,&fb->maxcells,
+    fb->ncells+font->charheight*(MAXLEN+1),sizeof(outchr));
+  if (fb->edges==NULL || fb->rowoff==NULL || fb->cells==NULL) {
+    return 0;
+    }
+
+  n = readrows(font,t,fb->cells+fb->ncells,fb->rowoff+fb->nrows,
+    fb->edges+fb->nrows);
+  for (row=0;row<font->charheight;row++) {
+    fb->rowoff[fb->nrows+row] += fb->ncells;
+    }
+  fb->chars[fb->nchars-1].width = fb->edges[fb->nrows].len;
+  fb->nrows += font->charheight;
+  fb->ncells += n;
+  return 1;
+}
+
+
+/****************************************************************************
+
+  charcmp
+
+  qsort comparison for the characters of a font being read: by ord,
+  and for the same ord, the one read last first.
+
+****************************************************************************/
+
+static int charcmp(const void *a, const void *b)
+{
+  const fcharinfo *ca = (const fcharinfo*)a;
+  const fcharinfo *cb = (const fcharinfo*)b;
+
+  if (ca->ord != cb->ord) return ca->ord < cb->ord ? -1 : 1;
+  return cb->row - ca->row;
+}
+
+
+/****************************************************************************
+
+  indexfont
+
+  Fills in the direct index of a font whose chars table is complete.
+
+****************************************************************************/
+
+static void indexfont(figlet_font *font)
+{
+  int i;
+
+  for (i=0;i<DIRECTCHARS;i++) {
+    font->directchar[i] = NULL;
+    }
+  for (i=0;i<font->nchars;i++) {
+    if (font->chars[i].ord>=0 && font->chars[i].ord<DIRECTCHARS) {
+      font->directchar[font->chars[i].ord] = &font->chars[i];
+      }
+    }
+}
+
+
+/****************************************************************************
+
+  figsparsechar
+
+  Looks up a character outside the direct index by binary search.
+  Returns NULL if the font has no such character.
+
+****************************************************************************/
+
+const fcharinfo *figsparsechar(const figlet_font *font, inchr c)
+{
+  int lo,hi,mid;
+
+  lo = 0;
+  hi = font->nchars-1;
+  while (lo<=hi) {
+    mid = (lo+hi)/2;
+    if (font->chars[mid].ord<c) {
+      lo = mid+1;
+      }
+    else if (font->chars[mid].ord>c) {
+      hi = mid-1;
+      }
+    else {
+      return &font->chars[mid];
+      }
+    }
+  return NULL;
+}
+
+
+/****************************************************************************
+
+  flbtable
+
+  Returns true if a table of n elements of the given size at offset
+  off fits in a compiled font of size bytes.
+
+****************************************************************************/
+
+static int flbtable(size_t size, int off, int n, size_t elsize)
+{
+  if (off<(int)sizeof(flbheader) || off%sizeof(int)!=0 || n<0 ||
+      (size_t)off>size) {
+    return 0;
+    }
+  return (size_t)n<=(size-off)/elsize;
+}
+
+
+/****************************************************************************
+
+  flbtables
+
+  Makes the tables of the font's compiled font image the font's.
+
+****************************************************************************/
+
+static void flbtables(figlet_font *font)
+{
+  const flbheader *h = (const flbheader*)font->image;
+  const char *base = (const char*)font->image;
+
+  font->hardblank = (char)h->hardblank;
+  font->charheight = h->charheight;
+  font->smushmode = h->smushmode;
+  font->right2left = h->right2left;
+  font->nchars = h->nchars;
+  font->nrows = h->nrows;
+  font->ncells = h->ncells;
+  font->chars = (const fcharinfo*)(base+h->charsoff);
+  font->edges = (const fcedge*)(base+h->edgesoff);
+  font->rowoff = (const int*)(base+h->rowsoff);
+  font->cells = base+h->cellsoff;
+  font->narrow = h->cellsize!=(int)sizeof(outchr);
+}
+
+
+/****************************************************************************
+
+  flbuse
+
+  Checks a compiled font image against the font file it was compiled
+  from and against this build, and if it is sound, makes its tables
+  the font's.  Every row of a character must be as wide as the
+  character, as readrows makes them.  Returns true on success.
+
+****************************************************************************/
+
+static int flbuse(figlet_font *font)
+{
+  const flbheader *h = (const flbheader*)font->image;
+  const fcharinfo *fc;
+  const fcedge *edge;
+  int i,row;
+
+  if (font->imagesize<sizeof(flbheader) ||
+      memcmp(h->magic,FLBMAGIC,4)!=0 || h->version!=FLBVERSION ||
+      h->byteorder!=FLBBYTEORDER || h->outchrsize!=(int)sizeof(outchr) ||
+      (h->cellsize!=(int)sizeof(outchr) &&
+       h->cellsize!=(int)sizeof(narrowchr)) ||
+      h->filesize<0 || (size_t)h->filesize!=font->imagesize ||
+      h->srcsize!=font->srcsize || h->srcmtime!=font->srcmtime ||
+      h->toiletfont!=font->toiletfont ||
+      h->charheight<1 || h->nrows<h->charheight ||
+      !flbtable(font->imagesize,h->charsoff,h->nchars,sizeof(fcharinfo)) ||
+      !flbtable(font->imagesize,h->rowsoff,h->nrows,sizeof(int)) ||
+      !flbtable(font->imagesize,h->edgesoff,h->nrows,sizeof(fcedge)) ||
+      !flbtable(font->imagesize,h->cellsoff,h->ncells,h->cellsize)) {
+    return 0;
+    }
+  flbtables(font);
+
+  for (i=0;i<font->nchars;i++) {
+    fc = &font->chars[i];
+    if (fc->row<0 || fc->row>font->nrows-font->charheight ||
+        fc->width!=font->edges[fc->row].len ||
+        (i>0 && fc->ord<=fc[-1].ord)) {
+      return 0;
+      }
+    for (row=1;row<font->charheight;row++) {  /* all as wide */
+      if (font->edges[fc->row+row].len!=fc->width) {
+        return 0;
+        }
+      }
+    }
+
+  for (i=0;i<font->nrows;i++) {
+    edge = &font->edges[i];
+    if (font->rowoff[i]<0 || edge->len<0 || edge->len>MAXLEN ||
+        font->rowoff[i]>=font->ncells-edge->len ||
+        FIGCELL(font->cells,font->narrow,font->rowoff[i]+edge->len)!='\0' ||
+        edge->left<0 || edge->left>edge->len ||
+        edge->right<-1 || edge->right>=edge->len) {
+      return 0;
+      }
+    }
+
+  indexfont(font);
+  return font->directchar[0]!=NULL;
+}
+
+
+/****************************************************************************
+
+  rowhash
+
+  Hashes a row of len cells (FNV-1a), and ORs the cells into *bitsp.
+
+****************************************************************************/
+
+static unsigned int rowhash(const outchr *line, int len, unsigned int *bitsp)
+{
+  unsigned int hash,bits;
+  int k;
+
+  hash = 2166136261U ^ (unsigned int)len;
+  bits = 0;
+  for (k=0;k<len;k++) {
+    hash = (hash ^ (unsigned int)line[k]) * 16777619U;
+    bits |= (unsigned int)line[k];
+    }
+  *bitsp |= bits;
+  return hash;
+}
+
+
+/****************************************************************************
+
+  freebuild
+
+  Releases the tables of a font being read.
+
+****************************************************************************/
+
+static void freebuild(fontbuild *fb)
+{
+  free(fb->chars);
+  free(fb->edges);
+  free(fb->rowoff);
+  free(fb->cells);
+}
+
+
+/****************************************************************************
+
+  internrows
+
+  Called by packfont.  Works out where in the font's cells each row of
+  the n characters it keeps goes, giving rows with the same content
+  the same place, so that each distinct row is stored once.  Row s is
+  row s%charheight of the s/charheight'th character; its place is
+  cellof[s].  Returns the number of cells the distinct rows take, and
+  sets *narrowp to whether they all fit in a narrowchr, or -1 if there
+  is no memory.
+
+****************************************************************************/
+
+static int internrows(const fontbuild *fb, int n, int charheight,
+  int *cellof, int *narrowp)
+{
+  int *slots;  /* 1 + the first row with each content, or 0 */
+  int nslots,nrows,s,t,r,len,ncells;
+  unsigned int i,bits;
+  const outchr *line;
+
+  nrows = n*charheight;
+  for (nslots=64;nslots<2*nrows;nslots*=2) ;
+  if ((slots = (int*)figalloc(sizeof(int)*nslots))==NULL) {
+    return -1;
+    }
+  memset(slots,0,sizeof(int)*nslots);
+  ncells = 0;
+  bits = 0;
+  for (s=0;s<nrows;s++) {
+    r = fb->chars[s/charheight].row+s%charheight;
+    line = fb->cells+fb->rowoff[r];
+    len = fb->edges[r].len;
+    for (i=rowhash(line,len,&bits)&(nslots-1);slots[i]!=0;i=(i+1)&(nslots-1)) {
+      t = slots[i]-1;
+      t = fb->chars[t/charheight].row+t%charheight;
+      if (fb->edges[t].len==len &&
+          memcmp(fb->cells+fb->rowoff[t],line,sizeof(outchr)*len)==0) {
+        break;
+        }
+      }
+    if (slots[i]!=0) {
+      cellof[s] = cellof[slots[i]-1];
+      }
+    else {
+      slots[i] = s+1;
+      cellof[s] = ncells;
+      ncells += len+1;
+      }
+    }
+  free(slots);
+  /* negative cells set the high bits too */
+  *narrowp = sizeof(outchr)>sizeof(narrowchr) &&
+    (bits&~(unsigned int)UCHAR_MAX)==0;
+  return ncells;
+}
+
+
+/****************************************************************************
+
+  packfont
+
+  Turns the tables of a font that has been read into the font's own,
+  laid out in one block exactly as figc writes a compiled font: the
+  header, then chars, rowoff, edges and cells.  The characters are
+  sorted, keeping the last definition of each ord, and their rows are
+  put in the same order; rows of definitions that were replaced are
+  left out, and rows that are the same as one before them share its
+  cells.  The cells are narrowed if they all fit in a narrowchr.
+  The block becomes the font's image, so a font that was read is
+  released just like one that was compiled.  Returns false if there is
+  no memory; either way, the tables that were read are released.
+
+****************************************************************************/
+
+static int packfont(figlet_font *font, fontbuild *fb)
+{
+  flbheader *h;
+  char *base;
+  fcharinfo *chars;
+  int *rowoff;
+  fcedge *edges;
+  narrowchr *ncell;
+  outchr *wcell;
+  const outchr *line;
+  int *cellof;
+  int i,k,n,row,r,s,len,nrows,ncells,narrow,off;
+
+  qsort(fb->chars,fb->nchars,sizeof(fcharinfo),charcmp);
+  n = 0;
+  for (i=0;i<fb->nchars;i++) {
+    if (n==0 || fb->chars[i].ord!=fb->chars[n-1].ord) {
+      fb->chars[n++] = fb->chars[i];
+      }
+    }
+
+  nrows = n*font->charheight;
+  ncells = -1;
+  narrow = 0;
+  if ((cellof = (int*)figalloc(sizeof(int)*nrows))!=NULL) {
+    ncells = internrows(fb,n,font->charheight,cellof,&narrow);
+    }
+  if (ncells>=0) {
+    font->imagesize = sizeof(flbheader)+sizeof(fcharinfo)*n+
+      (sizeof(int)+sizeof(fcedge))*nrows+
+      (narrow ? sizeof(narrowchr) : sizeof(outchr))*ncells;
+    font->image = figalloc(font->imagesize);
+    }
+  if (font->image==NULL) {
+    free(cellof);
+    freebuild(fb);
+    return 0;
+    }
+  font->imagemapped = 0;
+  base = (char*)font->image;
+  h = (flbheader*)base;
+  memset(h,0,sizeof(flbheader));
+  memcpy(h->magic,FLBMAGIC,4);
+  h->version = FLBVERSION;
+  h->byteorder = FLBBYTEORDER;
+  h->outchrsize = sizeof(outchr);
+  h->cellsize = narrow ? sizeof(narrowchr) : sizeof(outchr);
+  h->filesize = font->imagesize;
+  h->srcsize = font->srcsize;
+  h->srcmtime = font->srcmtime;
+  h->hardblank = font->hardblank;
+  h->charheight = font->charheight;
+  h->smushmode = font->smushmode;
+  h->right2left = font->right2left;
+  h->toiletfont = font->toiletfont;
+  h->nchars = n;
+  h->nrows = nrows;
+  h->ncells = ncells;
+  h->charsoff = sizeof(flbheader);
+  h->rowsoff = h->charsoff+sizeof(fcharinfo)*n;
+  h->edgesoff = h->rowsoff+sizeof(int)*nrows;
+  h->cellsoff = h->edgesoff+sizeof(fcedge)*nrows;
+  chars = (fcharinfo*)(base+h->charsoff);
+  rowoff = (int*)(base+h->rowsoff);
+  edges = (fcedge*)(base+h->edgesoff);
+  ncell = (narrowchr*)(base+h->cellsoff);
+  wcell = (outchr*)(base+h->cellsoff);
+
+  off = 0;
+  for (i=0;i<n;i++) {
+    chars[i] = fb->chars[i];
+    chars[i].row = i*font->charheight;
+    for (row=0;row<font->charheight;row++) {
+      s = chars[i].row+row;
+      r = fb->chars[i].row+row;
+      edges[s] = fb->edges[r];
+      rowoff[s] = cellof[s];
+      if (cellof[s]!=off) {  /* stored already */
+        continue;
+        }
+      line = fb->cells+fb->rowoff[r];
+      len = fb->edges[r].len;
+      if (narrow) {
+        for (k=0;k<=len;k++) {  /* with the NUL */
+          ncell[off+k] = (narrowchr)line[k];
+          }
+        }
+      else {
+        memcpy(wcell+off,line,sizeof(outchr)*(len+1));
+        }
+      off += len+1;
+      }
+    }
+
+  free(cellof);
+  freebuild(fb);
+  flbtables(font);  /* sound as built, so not checked as flbuse does */
+  indexfont(font);
+  return 1;
+}
+
+
+/****************************************************************************
+
+  freeimage
+
+  Releases the compiled font image of a font.
+
+****************************************************************************/
+
+static void freeimage(figlet_font *font)
+{
+#ifdef FIG_MMAP
+  if (font->imagemapped) {
+    munmap(font->image,font->imagesize);
+    }
+  else
+#endif
+    free(font->image);
+  font->image = NULL;
+}
+
+
+/****************************************************************************
+
+  flbload
+
+  Maps the compiled font at path into memory (or reads it, where
+  there is no mmap()) and uses it for the font.  Returns true on
+  success; on failure the font is left as it was.
+
+****************************************************************************/
+
+static int flbload(figlet_font *font, const char *path)
+{
+#ifdef FIG_MMAP
+  int fd;
+  struct stat st;
+
+  if ((fd = open(path,O_RDONLY))<0) {
+    return 0;
+    }
+  if (fstat(fd,&st)!=0 || st.st_size<(off_t)sizeof(flbheader)) {
+    close(fd);
+    return 0;
+    }
+  font->imagesize = st.st_size;
+  font->image = mmap(NULL,font->imagesize,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (font->image==MAP_FAILED) {
+    font->image = NULL;
+    return 0;
+    }
+  font->imagemapped = 1;
+#else
+  FILE *fp;
+  long size;
+
+  if ((fp = fopen(path,"rb"))==NULL) {
+    return 0;
+    }
+  if (fseek(fp,0L,SEEK_END)!=0 || (size = ftell(fp))<(long)sizeof(flbheader)) {
+    fclose(fp);
+    return 0;
+    }
+  rewind(fp);
+  font->imagesize = size;
+  if ((font->image = figalloc(font->imagesize))==NULL) {
+    fclose(fp);
+    return 0;
+    }
+  font->imagemapped = 0;
+  if (fread(font->image,1,font->imagesize,fp)!=font->imagesize) {
+    fclose(fp);
+    freeimage(font);
+    return 0;
+    }
+  fclose(fp);
+#endif
+
+  if (!flbuse(font)) {
+    freeimage(font);
+    return 0;
+    }
+  return 1;
+}
+
+
+/****************************************************************************
+
+  figflbwrite
+
+  Writes a font out as a compiled font: its image, which is laid out
+  as one whether it was read from the font file or from a compiled
+  font.  (A lazily loaded font has none, and cannot be written.)  The
+  file is written under a temporary name and renamed into place, so a
+  reader never sees it half written.  Where there is mkstemp(), the
+  temporary name is unique, so any number of processes can write the
+  same file at once.  Returns 0 on success, -1 with errno set on
+  failure.
+
+****************************************************************************/
+
+int figflbwrite(const figlet_font *font, const char *path)
+{
+  char *tmppath;
+  FILE *fp;
+  int ok;
+#ifdef FIG_MMAP
+  int fd;
+#endif
+
+  if (font->image==NULL) {  /* lazily loaded */
+    errno = EINVAL;
+    return -1;
+    }
+  if ((tmppath = figalloc(MYSTRLEN(path)+8))==NULL) {
+    errno = ENOMEM;
+    return -1;
+    }
+  strcpy(tmppath,path);
+#ifdef FIG_MMAP
+  strcat(tmppath,".XXXXXX");
+  if ((fd = mkstemp(tmppath))<0) {
+    free(tmppath);
+    return -1;
+    }
+  fchmod(fd,0644);  /* mkstemp() makes it private */
+  if ((fp = fdopen(fd,"wb"))==NULL) {
+    close(fd);
+    remove(tmppath);
+    free(tmppath);
+    return -1;
+    }
+#else
+  strcat(tmppath,".tmp");
+  if ((fp = fopen(tmppath,"wb"))==NULL) {
+    free(tmppath);
+    return -1;
+    }
+#endif
+  ok = fwrite(font->image,1,font->imagesize,fp)==font->imagesize;
+  if (fclose(fp)!=0) {
+    ok = 0;
+    }
+  if (ok && rename(tmppath,path)!=0) {
+    remove(path);  /* rename() will not replace a file everywhere */
+    ok = rename(tmppath,path)==0;
+    }
+  if (!ok) {
+    remove(tmppath);
+    }
+  free(tmppath);
+  return ok ? 0 : -1;
+}
+
+
+/****************************************************************************
+
+  cachepath
+
+  Returns the path (Alloc'd) that the image of the font file at path
+  has in the font cache cachedir.  It is named for the file and a
+  hash of its full path, so that fonts of the same name in different
+  directories are kept apart.  Whether the image is still that of the
+  font file is checked against the file's size and mtime when it is
+  loaded, as for any compiled font.  Returns NULL if there is no
+  memory.
+
+****************************************************************************/
+
+static char *cachepath(const char *cachedir, const char *path)
+{
+  char *full,*cpath;
+  const char *name,*p;
+  unsigned int h1,h2;
+
+#ifdef FIG_MMAP
+  full = realpath(path,NULL);
+#else
+  full = NULL;
+#endif
+  if (full==NULL) {
+    if ((full = figalloc(MYSTRLEN(path)+1))==NULL) {
+      return NULL;
+      }
+    strcpy(full,path);
+    }
+  h1 = 2166136261U;  /* FNV-1a */
+  h2 = 5381;         /* djb2 */
+  name = full;
+  for (p=full;*p!='\0';p++) {
+    h1 = (h1 ^ (unsigned char)*p) * 16777619U;
+    h2 = h2*33 + (unsigned char)*p;
+    if (*p==DIRSEP || *p==DIRSEP2) {
+      name = p+1;
+      }
+    }
+  cpath = figalloc(MYSTRLEN(cachedir)+MYSTRLEN(name)+MYSTRLEN(FLBSUFFIX)+19);
+  if (cpath==NULL) {
+    free(full);
+    return NULL;
+    }
+  sprintf(cpath,"%s%c%s-%08x%08x%s",cachedir,DIRSEP,name,h1,h2,FLBSUFFIX);
+  free(full);
+  return cpath;
+}
+
+
+/****************************************************************************
+
+  freefont
+
+  Releases a font and all of its characters.
+
+****************************************************************************/
+
+static void freefont(figlet_font *font)
+{
+  int i;
+
+  if (font->glyphs!=NULL) {
+    for (i=0;i<font->nchars;i++) {
+      free(font->glyphs[i]);
+      }
+    free(font->glyphs);
+    free((void*)font->chars);
+    }
+  free(font->charoff);
+  free(font->text);
+  freeimage(font);
+  free(font->path);
+  free(font);
+}
+
+
+/****************************************************************************
+
+  fontheader
+
+  Checks the magic number and header line read from a font file, and
+  sets the font's own settings from them.  Sets *maxlenp to the
+  longest a code tag line is read as, and *cmtlinesp to the number of
+  comment lines that follow the header.  Returns FIGLET_OK or the
+  error.
+
+****************************************************************************/
+
+static int fontheader(figlet_font *font, const char *magicnum,
+  const char *fileline, int *maxlenp, int *cmtlinesp)
+{
+  int numsread;
+  int maxlen,ffright2left;
+  int smush,smush2;
+
+  maxlen = 0;  /* in case the header is too short to have it */
+  numsread = sscanf(fileline,"%*c%c %d %*d %d %d %d %d %d",
+    &font->hardblank,&font->charheight,&maxlen,&smush,cmtlinesp,
+    &ffright2left,&smush2);
+
+  if (maxlen > MAXLEN) {
+    return FIGLET_ETOOWIDE;
+    }
+#ifdef TLF_FONTS
+  if ((!font->toiletfont && strcmp(magicnum,FONTFILEMAGICNUMBER)) ||
+      (font->toiletfont && strcmp(magicnum,TOILETFILEMAGICNUMBER)) ||
+      numsread<5) {
+#else
+  if (strcmp(magicnum,FONTFILEMAGICNUMBER) || numsread<5) {
+#endif
+    return FIGLET_EFONTFMT;
+    }
+
+  if (numsread<6) {
+    ffright2left = 0;
+    }
+
+  if (numsread<7) { /* if no smush2, decode smush into smush2 */
+    if (smush == 0) smush2 = SM_KERN;
+    else if (smush < 0) smush2 = 0;
+    else smush2 = (smush & 31) | SM_SMUSH;
+    }
+
+  if (font->charheight<1) {
+    font->charheight = 1;
+    }
+
+  if (maxlen<1) {
+    maxlen = 1;
+    }
+
+  *maxlenp = maxlen+100; /* Give ourselves some extra room */
+
+  font->smushmode = smush2;
+  font->right2left = ffright2left;
+  return FIGLET_OK;
+}
+
+
+/****************************************************************************
+
+  readtext
+
+  Reads all of a font file, unzipping it if it is zipped, into an
+  Alloc'd buffer.  Returns the buffer and sets *sizep, or returns NULL
+  and sets *errp if the file cannot be opened or there is no memory
+  to read it.
+
+****************************************************************************/
+
+static char *readtext(const char *path, size_t *sizep, int *errp)
+{
+  ZFILE *fp;
+  char *text;
+  int len,max;
+  size_t n;
+
+  errno = 0;
+  if ((fp = figzopen(path))==NULL) {
+    *errp = errno==ENOMEM ? FIGLET_ENOMEM : FIGLET_ENOFONT;
+    return NULL;
+    }
+  text = NULL;
+  len = max = 0;
+  do {
+    if ((text = (char*)figgrow(text,&max,len+BUFSIZ,1))==NULL) {
+      errno = ENOMEM;
+      break;
+      }
+    n = Zread(text+len,1,max-len,fp);
+    len += n;
+    } while (n>0);
+  Zclose(fp);
+  if (errno==ENOMEM) {  /* a zipped file that cannot be inflated ends early */
+    free(text);
+    *errp = FIGLET_ENOMEM;
+    return NULL;
+    }
+  *sizep = len;
+  return text;
+}
+
+
+/****************************************************************************
+
+  textheader
+
+  Starts reading a font file in memory: reads its header and skips
+  the comments after it, leaving t at the first character.  Sets
+  *maxlenp as fontheader does.  Returns FIGLET_OK or the error.
+
+****************************************************************************/
+
+static int textheader(figlet_font *font, fonttext *t, int *maxlenp)
+{
+  int i,err,cmtlines;
+  char fileline[MAXLEN+1],magicnum[5];
+
+  t->p = font->text;
+  t->end = font->text+font->textsize;
+  textmagic(t,magicnum);
+  if (!textgets(t,fileline,MAXLEN)) {
+    fileline[0] = '\0';
+    }
+  if (MYSTRLEN(fileline)>0 ? fileline[MYSTRLEN(fileline)-1]!='\n' : 0) {
+    textskiptoeol(t);
+    }
+  if ((err = fontheader(font,magicnum,fileline,maxlenp,&cmtlines))
+      !=FIGLET_OK) {
+    return err;
+    }
+  for (i=1;i<=cmtlines;i++) {
+    textskiptoeol(t);
+    }
+  return FIGLET_OK;
+}
+
+
+/****************************************************************************
+
+  readtextfont
+
+  Called by figfontload, once the font file is in memory: reads the
+  font, all of it, and packs it into the font's image.  Returns
+  FIGLET_OK or the error.
+
+****************************************************************************/
+
+static int readtextfont(figlet_font *font)
+{
+  fonttext t;
+  fontbuild fb;
+  int err,maxlen,ok;
+  inchr theord;
+  char fileline[MAXLEN+102];  /* code tags: maxlen+1 */
+
+  if ((err = textheader(font,&t,&maxlen))!=FIGLET_OK) {
+    return err;
+    }
+  memset(&fb,0,sizeof(fb));
+
+  ok = readfontchar(font,&fb,NULL,0);  /* "missing" character */
+  for (theord=' ';ok && theord<='~';theord++) {
+    ok = readfontchar(font,&fb,&t,theord);
+    }
+  for (theord=0;ok && theord<=6;theord++) {
+    ok = readfontchar(font,&fb,&t,deutsch[theord]);
+    }
+  while (ok && textgets(&t,fileline,maxlen+1) &&
+    sscanf(fileline,"%li",&theord)==1) {
+    ok = readfontchar(font,&fb,&t,theord);
+    }
+  if (!ok) {
+    freebuild(&fb);
+    return FIGLET_ENOMEM;
+    }
+  return packfont(font,&fb) ? FIGLET_OK : FIGLET_ENOMEM;
+}
+
+
+/****************************************************************************
+
+  fontindex
+
+  The index of a lazily loaded font while its font file is scanned:
+  its characters in the order they are defined, each with row set to
+  the number of its definition, and off[row] where its rows start in
+  the font file, or -1 for the "missing" character, which has none.
+
+****************************************************************************/
+
+typedef struct {
+  fcharinfo *chars;
+  long *off;
+  int nchars,maxchars,maxoff;
+  } fontindex;
+
+
+/****************************************************************************
+
+  indexchar
+
+  Adds a character whose rows start at offset off to the index of a
+  lazily loaded font.  Returns false if there is no memory.
+
+****************************************************************************/
+
+static int indexchar(fontindex *fi, inchr theord, long off)
+{
+  fcharinfo *fc;
+
+  fi->chars = (fcharinfo*)figgrow(fi->chars,&fi->maxchars,fi->nchars+1,
+    sizeof(fcharinfo));
+  fi->off = (long*)figgrow(fi->off,&fi->maxoff,fi->nchars+1,sizeof(long));
+  if (fi->chars==NULL || fi->off==NULL) {
+    return 0;
+    }
+  fc = &fi->chars[fi->nchars];
+  fc->ord = (int)theord;
+  fc->width = 0;
+  fc->row = fi->nchars;
+  fi->off[fi->nchars++] = off;
+  return 1;
+}
+
+
+/****************************************************************************
+
+  skipfontchar
+
+  Adds the character whose rows are next in a font file in memory to
+  the index of a lazily loaded font, and skips its rows.  Returns
+  false if there is no memory.
+
+****************************************************************************/
+
+static int skipfontchar(figlet_font *font, fontindex *fi, fonttext *t,
+  inchr theord)
+{
+  const char *line;
+  int row,n;
+
+  if (!indexchar(fi,theord,(long)(t->p-font->text))) {
+    return 0;
+    }
+  for (row=0;row<font->charheight;row++) {
+    textline(t,MAXLEN,&line,&n);
+    }
+  return 1;
+}
+
+
+/****************************************************************************
+
+  indextext
+
+  Called by figfontload for a lazily loaded font, once its font file
+  is in memory.  Reads the header and indexes the characters: finds
+  the ord of each one and where its rows start, but reads no rows.
+  The index is sorted, keeping the last definition of each ord, and
+  becomes the font's chars and charoff.  Returns FIGLET_OK or the
+  error.
+
+****************************************************************************/
+
+static int indextext(figlet_font *font)
+{
+  fonttext t;
+  fontindex fi;
+  int i,n,err,maxlen,ok;
+  inchr theord;
+  char fileline[MAXLEN+102];  /* code tags: maxlen+1 */
+
+  if ((err = textheader(font,&t,&maxlen))!=FIGLET_OK) {
+    return err;
+    }
+
+  memset(&fi,0,sizeof(fi));
+  ok = indexchar(&fi,0,-1L);  /* "missing" character */
+  for (theord=' ';ok && theord<='~';theord++) {
+    ok = skipfontchar(font,&fi,&t,theord);
+    }
+  for (theord=0;ok && theord<=6;theord++) {
+    ok = skipfontchar(font,&fi,&t,deutsch[theord]);
+    }
+  while (ok && textgets(&t,fileline,maxlen+1) &&
+    sscanf(fileline,"%li",&theord)==1) {
+    ok = skipfontchar(font,&fi,&t,theord);
+    }
+  if (!ok) {
+    free(fi.chars);
+    free(fi.off);
+    return FIGLET_ENOMEM;
+    }
+
+  qsort(fi.chars,fi.nchars,sizeof(fcharinfo),charcmp);
+  n = 0;
+  for (i=0;i<fi.nchars;i++) {
+    if (n==0 || fi.chars[i].ord!=fi.chars[n-1].ord) {
+      fi.chars[n++] = fi.chars[i];
+      }
+    }
+  font->charoff = (long*)figalloc(sizeof(long)*n);
+  font->glyphs = (figglyph**)figalloc(sizeof(figglyph*)*n);
+  if (font->charoff==NULL || font->glyphs==NULL) {
+    free(font->glyphs);
+    font->glyphs = NULL;
+    free(fi.chars);
+    free(fi.off);
+    return FIGLET_ENOMEM;
+    }
+  for (i=0;i<n;i++) {
+    font->charoff[i] = fi.off[fi.chars[i].row];
+    font->glyphs[i] = NULL;
+    fi.chars[i].row = 0;
+    }
+  free(fi.off);
+  font->chars = fi.chars;
+  font->nchars = n;
+  indexfont(font);
+  return FIGLET_OK;
+}
+
+
+/****************************************************************************
+
+  readglyph
+
+  Reads character i of a lazily loaded font from its font file, into
+  a figglyph with its tables just after it, and publishes it in the
+  font's glyphs.  Its rows are read by readrows, as when the whole
+  font is read, so it is the same glyph either way.  If another
+  thread got there first, its glyph is used and this one dropped.
+  Returns the glyph, or NULL if there is no memory.
+
+****************************************************************************/
+
+static const figglyph *readglyph(figlet_font *font, int i)
+{
+  figglyph *g,*ng;
+  fonttext t;
+  int *rowoff;
+  fcedge *edges;
+  outchr *cells;
+  int ncells;
+
+  /* Room for the longest rows, given back once they are read */
+  g = (figglyph*)figalloc(sizeof(figglyph)+
+    (sizeof(int)+sizeof(fcedge)+sizeof(outchr)*(MAXLEN+1))*font->charheight);
+  if (g==NULL) {
+    return NULL;
+    }
+  rowoff = (int*)(g+1);
+  edges = (fcedge*)(rowoff+font->charheight);
+  cells = (outchr*)(edges+font->charheight);
+
+  if (font->charoff[i]<0) {  /* the "missing" character */
+    ncells = readrows(font,NULL,cells,rowoff,edges);
+    }
+  else {
+    t.p = font->text+font->charoff[i];
+    t.end = font->text+font->textsize;
+    ncells = readrows(font,&t,cells,rowoff,edges);
+    }
+
+  ng = (figglyph*)realloc(g,(char*)(cells+ncells)-(char*)g);
+  if (ng!=NULL) {
+    g = ng;
+    }
+  rowoff = (int*)(g+1);
+  g->rowoff = rowoff;
+  g->edges = (fcedge*)(rowoff+font->charheight);
+  g->cells = g->edges+font->charheight;
+  g->narrow = 0;
+  g->width = g->edges[0].len;
+
+  if (!GLYPHSET(font->glyphs[i],g)) {
+    free(g);
+    g = GLYPHGET(font->glyphs[i]);
+    }
+  return g;
+}
+
+
+/****************************************************************************
+
+  figlazyglyph
+
+  Returns the character of a lazily loaded font for ord c, or its
+  "missing" character if it has none, reading it if it has not been
+  read yet.  Returns NULL if it cannot be read for want of memory.
+
+****************************************************************************/
+
+const figglyph *figlazyglyph(figlet_font *font, inchr c)
+{
+  const fcharinfo *fc;
+  const figglyph *g;
+  int i;
+
+  fc = FIGFINDCHAR(font,c);
+  if (fc==NULL) {
+    fc = font->directchar[0];
+    }
+  i = fc-font->chars;
+  if ((g = GLYPHGET(font->glyphs[i]))!=NULL) {
+    return g;
+    }
+  return readglyph(font,i);
+}
+
+
+/****************************************************************************
+
+  figfontload
+
+  Allocates memory, initializes variables, and reads in the font.
+  Only the font's own settings are recorded; the caller's options
+  are applied by the context at render time.  If useflb is true and
+  there is a sound compiled font next to the font file, that is used
+  instead of reading the font file.  Otherwise, if cachedir is not
+  NULL and has a sound image of the font file, that is used; if it
+  has none, the font file is read in full, and its image written
+  there for next time.  Otherwise, if lazy is true, the font file is
+  only indexed, and each character read when it is first rendered.
+  Returns NULL and sets *errp on failure.
+
+****************************************************************************/
+
+figlet_font *figfontload(const char *fontdir, const char *fontname,
+  int useflb, int lazy, const char *cachedir, int *errp)
+{
+  int i;
+  char *flbpath,*cachefile;
+  figlet_font *font;
+  struct stat st;
+  const char *suffix = FONTFILESUFFIX;
+  int toiletfont = 0;
+  char *path;
+  figarc *arc;
+  const char *name;
+
+  errno = 0;
+  path = figfindfile(fontdir,fontname,FONTFILESUFFIX);
+#ifdef TLF_FONTS
+  if (path==NULL && errno!=ENOMEM) {
+    suffix = TOILETFILESUFFIX;
+    path = figfindfile(fontdir,fontname,TOILETFILESUFFIX);
+    if(path) toiletfont = 1;
+    }
+#endif
+
+  if (path==NULL) {
+    *errp = errno==ENOMEM ? FIGLET_ENOMEM : FIGLET_ENOFONT;
+    return NULL;
+    }
+
+  if ((font = (figlet_font*)figalloc(sizeof(figlet_font)))==NULL) {
+    free(path);
+    *errp = FIGLET_ENOMEM;
+    return NULL;
+    }
+  memset(font,0,sizeof(figlet_font));
+  font->refcount = 1;
+  font->path = path;
+  font->toiletfont = toiletfont;
+  ARCLOCK(archivelock);
+  if ((arc = figmember(path,&name))!=NULL) {
+    font->srcsize = (unsigned int)Zmember_size(arc->archive,name);
+    font->srcmtime = (unsigned int)arc->st.st_mtime;
+    }
+  ARCUNLOCK(archivelock);
+  if (arc==NULL && stat(path,&st)==0) {
+    font->srcsize = (unsigned int)st.st_size;
+    font->srcmtime = (unsigned int)st.st_mtime;
+    }
+
+  if (useflb) {
+    i = MYSTRLEN(path)-MYSTRLEN(suffix);
+    if ((flbpath = figalloc(i+MYSTRLEN(FLBSUFFIX)+1))==NULL) {
+      freefont(font);
+      *errp = FIGLET_ENOMEM;
+      return NULL;
+      }
+    memcpy(flbpath,path,i);
+    strcpy(flbpath+i,FLBSUFFIX);
+    i = flbload(font,flbpath);
+    free(flbpath);
+    if (i) {
+      *errp = FIGLET_OK;
+      return font;
+      }
+    }
+
+  cachefile = NULL;
+  if (cachedir!=NULL) {
+    cachefile = cachepath(cachedir,path);
+    if (cachefile!=NULL && flbload(font,cachefile)) {
+      free(cachefile);
+      *errp = FIGLET_OK;
+      return font;
+      }
+    lazy = 0;  /* the whole image is needed to write */
+    }
+
+  if ((font->text = readtext(path,&font->textsize,errp))!=NULL) {
+    if (!lazy) {
+      *errp = readtextfont(font);
+      free(font->text);  /* what is needed of it is in the image now */
+      font->text = NULL;
+      }
+    /* The "missing" character is read now, so that the renderer has
+       it to fall back on if another cannot be read for want of memory */
+    else if ((*errp = indextext(font))==FIGLET_OK &&
+        figlazyglyph(font,0)==NULL) {
+      *errp = FIGLET_ENOMEM;
+      }
+    }
+  if (*errp==FIGLET_OK && cachefile!=NULL) {
+    figflbwrite(font,cachefile);  /* if it cannot, it is read next time */
+    }
+  free(cachefile);
+  if (*errp!=FIGLET_OK) {
+    freefont(font);
+    return NULL;
+    }
+  return font;
+}
+
+
+/****************************************************************************
+
+  figlet_font_load
+
+  Loads a font, using its compiled form if there is a sound one.
+  Returns NULL and sets *errp on failure.
+
+****************************************************************************/
+
+figlet_font *figlet_font_load(const char *fontdir, const char *fontname,
+  int *errp)
+{
+  return figfontload(fontdir,fontname,1,0,NULL,errp);
+}
+
+
+/****************************************************************************
+
+  figlet_font_load_lazy
+
+  Loads a font as figlet_font_load does, except that a font file is
+  only indexed, and each of its characters is read the first time it
+  is rendered.  Best for rendering a little text in a big font.
+  Returns NULL and sets *errp on failure.
+
+****************************************************************************/
+
+figlet_font *figlet_font_load_lazy(const char *fontdir, const char *fontname,
+  int *errp)
+{
+  return figfontload(fontdir,fontname,1,1,NULL,errp);
+}
+
+
+/****************************************************************************
+
+  figlet_font_load_cached
+
+  Loads a font as figlet_font_load does, except that a font file is
+  read from the font cache cachedir, an existing directory, if it has
+  a sound image of it.  Otherwise the font file is read, and its image
+  written there for next time.  The image is mapped into memory, so
+  processes using the same font share one copy.  Returns NULL and sets
+  *errp on failure.
+
+****************************************************************************/
+
+figlet_font *figlet_font_load_cached(const char *fontdir,
+  const char *fontname, const char *cachedir, int *errp)
+{
+  return figfontload(fontdir,fontname,1,0,cachedir,errp);
+}
+
+
+/****************************************************************************
+
+  figlet_font_ref
+
+  Takes another reference to a font.
+
+****************************************************************************/
+
+figlet_font *figlet_font_ref(figlet_font *font)
+{
+  REFINC(font->refcount);
+  return font;
+}
+
+
+/****************************************************************************
+
+  figlet_font_unref
+
+  Drops a reference to a font, releasing it with the last one.
+
+****************************************************************************/
+
+void figlet_font_unref(figlet_font *font)
+{
+  if (font==NULL) return;
+  if (REFDEC(font->refcount)==0) {
+    freefont(font);
+    }
+}
+
+
+/****************************************************************************
+
+  intcmp
+
+  qsort comparison for ints.
+
+****************************************************************************/
+
+static int intcmp(const void *a, const void *b)
+{
+  int ia = *(const int*)a;
+  int ib = *(const int*)b;
+
+  return ia<ib ? -1 : ia>ib;
+}
+
+
+/****************************************************************************
+
+  figlet_font_info
+
+  Reports how much a font holds and how much of it is stored: the
+  rows of its characters, and how many of them are distinct, which
+  are all that is stored.  Of a lazily loaded font, only the
+  characters read so far are counted, and none of their rows are
+  shared.
+
+****************************************************************************/
+
+void figlet_font_info(const figlet_font *font, figlet_fontinfo *info)
+{
+  const figglyph *g;
+  int *rowoff;
+  int i,row;
+  size_t n;
+
+  if (font->glyphs!=NULL) {
+    memset(info,0,sizeof(figlet_fontinfo));
+    info->size = font->textsize+
+      (sizeof(fcharinfo)+sizeof(long)+sizeof(figglyph*))*font->nchars;
+    for (i=0;i<font->nchars;i++) {
+      if ((g = GLYPHGET(font->glyphs[i]))==NULL) continue;
+      n = 0;
+      for (row=0;row<font->charheight;row++) {
+        n += g->edges[row].len+1;
+        }
+      info->chars++;
+      info->cells += n;
+      info->size += sizeof(figglyph)+
+        (sizeof(int)+sizeof(fcedge))*font->charheight+sizeof(outchr)*n;
+      }
+    info->rows = info->uniquerows = info->chars*font->charheight;
+    info->uniquecells = info->cells;
+    return;
+    }
+
+  info->chars = font->nchars;
+  info->rows = font->nrows;
+  info->cells = 0;
+  for (i=0;i<font->nrows;i++) {
+    info->cells += font->edges[i].len+1;
+    }
+  info->uniquecells = font->ncells;
+  info->size = font->imagesize;
+
+  if ((rowoff = (int*)figalloc(sizeof(int)*font->nrows))==NULL) {
+    info->uniquerows = info->rows;  /* as if none were shared */
+    return;
+    }
+  memcpy(rowoff,font->rowoff,sizeof(int)*font->nrows);
+  qsort(rowoff,font->nrows,sizeof(int),intcmp);
+  info->uniquerows = 0;
+  for (i=0;i<font->nrows;i++) {
+    if (i==0 || rowoff[i]!=rowoff[i-1]) {
+      info->uniquerows++;
+      }
+    }
+  free(rowoff);
+}
@@ -0,0 +1,263 @@
+/****************************************************************************
+
+  FIGlet Copyright 1991, 1993, 1994 Glenn Chappell and Ian Chai
+  FIGlet Copyright 1996, 1997, 1998, 1999, 2000, 2001 John Cowan
+  FIGlet Copyright 2002 Christiaan Keet
+  FIGlet Copyright 2011, 2012 Claudio Matsuoka
+  Portions written by Paul Burton and Christiaan Keet
+  Internet: <info@figlet.org>
+  FIGlet, along with the various FIGlet fonts and documentation, is
+    copyrighted under the provisions of the New BSD License (3-clause)
+    (as listed in the file "LICENSE" which is included in this package)
+****************************************************************************/
+
+/*
+ * figint.h - libfiglet internals shared between its source files
+ *
+ * Nothing in here is part of the library interface; see figlet.h.
+ */
+
+#ifndef __FIGINT_H
+#define __FIGINT_H
+
+#include <string.h>
+#include <ctype.h>
+
+#ifdef TLF_FONTS
+#include <wchar.h>
+#include <wctype.h>
+#endif
+
+#include "figlet.h"
+#include "zipio.h"
+
+#define MYSTRLEN(x) ((int)strlen(x)) /* Eliminate ANSI problem */
+
+/* Systems with mmap() and the POSIX file calls */
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#define FIG_MMAP
+#endif
+
+#define MAXLEN 255     /* Maximum character width */
+
+
+/****************************************************************************
+
+  Chars that are read
+
+****************************************************************************/
+
+typedef long inchr; /* "char" read from input */
+
+extern const inchr deutsch[7];
+
+
+/****************************************************************************
+
+  Chars that are written
+
+****************************************************************************/
+
+#ifdef TLF_FONTS
+typedef wchar_t outchr; /* "char" written to output */
+#define STRLEN(x) wcslen(x)
+#define STRCPY(x,y) wcscpy((x),(y))
+#define STRCAT(x,y) wcscat((x),(y))
+#define ISSPACE(x) iswspace(x)
+#else
+typedef char outchr; /* "char" written to output */
+#define STRLEN(x) MYSTRLEN(x)
+#define STRCPY(x,y) strcpy((x),(y))
+#define STRCAT(x,y) strcat((x),(y))
+#define ISSPACE(x) isspace(x)
+#endif
+
+
+/****************************************************************************
+
+  Fonts
+
+  A figlet_font is never modified once figlet_font_load() returns it,
+  so any number of contexts (and threads) may render with it at the
+  same time.  Only the reference count changes, atomically, and the
+  glyphs of a lazily loaded font as they are read (see below).
+
+  A font is kept in a few flat tables rather than in an allocation per
+  character and row.  The tables are all in one block, the font's
+  image, laid out as figc writes a compiled font, so that a compiled
+  font can be used straight from its file and a font read from its
+  font file is built with a handful of allocations and released with
+  one:
+
+    chars[nchars]  one entry per ord, sorted by ord
+    edges[nrows]   the edge profile of each row of each character
+    rowoff[nrows]  where each row starts in cells
+    cells[ncells]  the rows themselves, each one NUL-terminated
+
+  The rows of character fc are those at rowoff[fc->row] to
+  rowoff[fc->row+charheight-1], and likewise for edges.  Ord 0 is
+  always there: it is the character used for ords the font has none
+  for.
+
+  When outchr is wider than a byte, the cells of a font whose chars
+  all fit in one (every FIGfont, and most TOIlet fonts) are kept as
+  narrowchr, a quarter of the size; only the fonts that need more are
+  kept as outchr.  FIGCELL reads either kind.
+
+  A font loaded with figlet_font_load_lazy from its font file has no
+  image.  The font file is kept in memory as it is, and only indexed
+  when the font is loaded: chars holds each ord, and charoff where in
+  the file its rows are.  A character is read the first time it is
+  rendered, into a figglyph of its own, which is kept in glyphs for
+  every later use.  Reading one changes nothing a renderer already
+  uses, and the glyph is published with an atomic swap, so such a
+  font is shared between threads like any other.
+
+****************************************************************************/
+
+/*
+ * Edge profile of one row of a character, worked out at load time so
+ * that smushing never has to scan the character's rows.  All ints so
+ * that it is laid out the same in every build.
+ */
+typedef struct {
+  int len;        /* STRLEN(row) */
+  int left;       /* number of leading ' ' */
+  int right;      /* index of the last char other than ' ', or -1 */
+  int leftch;     /* row[left] */
+  int rightch;    /* row[right], or row[0] if right<0 */
+  } fcedge;
+
+typedef struct {
+  int ord;
+  int width;      /* STRLEN of the first row */
+  int row;        /* index of the first row in rows and edges */
+  } fcharinfo;    /* (only ord is set in a lazily loaded font) */
+
+/*
+ * A character as the renderer sees it: its rows, wherever they are
+ * kept.  A character of a lazily loaded font is read into one of
+ * these, with its tables in the same block, just after it.
+ */
+typedef struct {
+  const int *rowoff;    /* where each row starts in cells */
+  const fcedge *edges;
+  const void *cells;    /* narrowchr cells if narrow, else outchr */
+  int narrow;
+  int width;
+  } figglyph;
+
+#define DIRECTCHARS 256  /* ords looked up by direct index */
+
+typedef unsigned char narrowchr;  /* cell of a narrow font */
+
+struct figlet_font {
+  int refcount;
+  char hardblank;
+  int charheight;
+  int smushmode;     /* the font's own smushmode (full layout) */
+  int right2left;    /* the font's own print direction */
+  int toiletfont;    /* true if font is a TOIlet TLF font */
+  int nchars,nrows,ncells;
+  const fcharinfo *chars;
+  const fcharinfo *directchar[DIRECTCHARS];  /* ords 0..DIRECTCHARS-1 */
+  const fcedge *edges;
+  const int *rowoff;
+  const void *cells; /* narrowchr cells[ncells] if narrow, */
+  int narrow;        /* else outchr cells[ncells] */
+  char *path;        /* Alloc'd: the font file read */
+  unsigned int srcsize,srcmtime;  /* of that file */
+  void *image;       /* the block the tables are in: Alloc'd, */
+  size_t imagesize;  /* or a compiled font mmap()ed if */
+  int imagemapped;   /* imagemapped is true */
+  figglyph **glyphs; /* Lazily loaded fonts only, else NULL: Alloc'd */
+                     /* glyphs[nchars], each NULL until chars[i] is */
+                     /* first rendered, then Alloc'd */
+  long *charoff;     /* Alloc'd: where in text the rows of chars[i] */
+                     /* start, or -1 for the missing character */
+  char *text;        /* Alloc'd: the whole font file */
+  size_t textsize;
+  };
+
+
+/****************************************************************************
+
+  Compiled fonts
+
+  figc writes a font out as a .flb file: this header, then the tables
+  chars, rowoff, edges and cells, each at the offset the header gives.
+  Everything is in the byte order and outchr size of the build that
+  compiled it; a .flb that does not match the build reading it, or
+  the font file next to it, is ignored and the font file is read
+  instead.
+
+****************************************************************************/
+
+#define FLBSUFFIX ".flb"
+#define FLBMAGIC "flb\032"
+#define FLBVERSION 2
+#define FLBBYTEORDER 0x01020304
+
+typedef struct {
+  char magic[4];          /* FLBMAGIC */
+  int version;            /* FLBVERSION */
+  int byteorder;          /* FLBBYTEORDER */
+  int outchrsize;         /* sizeof(outchr) */
+  int cellsize;           /* sizeof(narrowchr) if narrow, else outchrsize */
+  int filesize;
+  unsigned int srcsize;   /* size and mtime of the font file */
+  unsigned int srcmtime;
+  int hardblank;
+  int charheight;
+  int smushmode;
+  int right2left;
+  int toiletfont;
+  int nchars,nrows,ncells;
+  int charsoff,rowsoff,edgesoff,cellsoff;  /* offsets in the file */
+  } flbheader;
+
+
+/****************************************************************************
+
+  Routines shared between the library sources
+
+****************************************************************************/
+
+char  *figalloc(size_t size);
+char  *figfindfile(const char *fontdir, const char *name,
+         const char *suffix);
+ZFILE *FIGopen(const char *fontdir, const char *name, const char *suffix);
+void   figskiptoeol(ZFILE *fp);
+const fcharinfo *figsparsechar(const figlet_font *font, inchr c);
+const figglyph *figlazyglyph(figlet_font *font, inchr c);
+figlet_font *figfontload(const char *fontdir, const char *fontname,
+         int useflb, int lazy, const char *cachedir, int *errp);
+int    figflbwrite(const figlet_font *font, const char *path);
+
+/****************************************************************************
+
+  FIGFINDCHAR
+
+  Returns the font's character for ord c, or NULL if it has none.
+
+****************************************************************************/
+
+#define FIGFINDCHAR(font,c)                           \
+  (((c)>=0 && (c)<DIRECTCHARS) ? (font)->directchar[c] \
+                               : figsparsechar((font),(c)))
+
+
+/****************************************************************************
+
+  FIGCELL
+
+  Returns the cell at offset off in cells, narrowchr cells if narrow
+  is true and else outchr cells, as an outchr.
+
+****************************************************************************/
+
+#define FIGCELL(cells,narrow,off)                         \
+  ((narrow) ? (outchr)((const narrowchr*)(cells))[off]     \
+            : ((const outchr*)(cells))[off])
+
+#endif
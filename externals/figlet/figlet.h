@@ -0,0 +1,171 @@
+/****************************************************************************
+
+  FIGlet Copyright 1991, 1993, 1994 Glenn Chappell and Ian Chai
+  FIGlet Copyright 1996, 1997, 1998, 1999, 2000, 2001 John Cowan
+  FIGlet Copyright 2002 Christiaan Keet
+  FIGlet Copyright 2011, 2012 Claudio Matsuoka
+  Portions written by Paul Burton and Christiaan Keet
+  Internet: <info@figlet.org>
+  FIGlet, along with the various FIGlet fonts and documentation, is
+    copyrighted under the provisions of the New BSD License (3-clause)
+    (as listed in the file "LICENSE" which is included in this package)
+****************************************************************************/
+
+/*
+ * figlet.h - libfiglet, the FIGlet rendering engine
+ *
+ * All rendering state lives in a figlet_context: a font, the rendering
+ * options, the control file mappings and the line buffers.  Nothing is
+ * kept in globals, so any number of contexts can be used at the same
+ * time, and a context can render any number of texts.
+ *
+ * Fonts are loaded separately into a figlet_font, which is immutable
+ * and reference counted.  One font can be shared by many contexts,
+ * including contexts used by different threads, without locking; each
+ * thread just needs a context of its own.  The options (smushing,
+ * direction, justification, width) belong to the context and are
+ * applied at render time, so they never change the font.
+ *
+ * Typical use:
+ *
+ *   figlet_options opts;
+ *   figlet_font *font;
+ *   figlet_context *ctx;
+ *   int err;
+ *
+ *   font = figlet_font_load(fontdir,"standard",&err);
+ *   figlet_defaults(&opts);
+ *   ctx = figlet_new(&opts);
+ *   figlet_set_font(ctx,font);
+ *   figlet_render(ctx,"Hello",5,callback);
+ *   figlet_free(ctx);
+ *   figlet_font_unref(font);
+ *
+ * The input can be a memory buffer, a file descriptor, a named file
+ * (mapped into memory where possible), a list of words as the figlet
+ * command takes them, or a callback returning one byte at a time.
+ * All but the callback are read in place or a block at a time.
+ *
+ * The output callback receives the rendered text, already encoded
+ * (UTF-8 for TLF fonts), one chunk at a time.
+ *
+ * The library never exits or prints: running out of memory is
+ * returned as FIGLET_ENOMEM like any other error (figlet_new returns
+ * NULL), and the context and fonts can still be freed.
+ */
+
+#ifndef __FIGLET_H
+#define __FIGLET_H
+
+#include <stddef.h>
+
+#define FONTFILESUFFIX ".flf"
+#define FONTFILEMAGICNUMBER "flf2"
+#define CONTROLFILESUFFIX ".flc"
+#define CONTROLFILEMAGICNUMBER "flc2"   /* no longer used in 2.2 */
+#define TOILETFILESUFFIX ".tlf"
+#define TOILETFILEMAGICNUMBER "tlf2"
+#define DEFAULTCOLUMNS 80
+
+/* Smushmode bits */
+#define SM_SMUSH 128
+#define SM_KERN 64
+#define SM_EQUAL 1
+#define SM_LOWLINE 2
+#define SM_HIERARCHY 4
+#define SM_PAIR 8
+#define SM_BIGX 16
+#define SM_HARDBLANK 32
+
+/* Smushmode override modes */
+#define SMO_NO 0     /* no command-line smushmode */
+#define SMO_YES 1    /* use command-line smushmode, ignore font smushmode */
+#define SMO_FORCE 2  /* logically OR command-line and font smushmodes */
+
+/* Error codes */
+#define FIGLET_OK 0
+#define FIGLET_ENOFONT 1     /* font file not found */
+#define FIGLET_EFONTFMT 2    /* not a FIGlet 2 font file */
+#define FIGLET_ETOOWIDE 3    /* font character is too wide */
+#define FIGLET_ENOCTRL 4     /* control file not found */
+#define FIGLET_ENOFONTSET 5  /* rendering without a loaded font */
+#define FIGLET_EOUTPUT 6     /* output callback failed */
+#define FIGLET_ENOINPUT 7    /* input file not found */
+#define FIGLET_EINPUT 8      /* reading the input failed */
+#define FIGLET_ENOMEM 9      /* out of memory */
+
+typedef struct figlet_context figlet_context;
+typedef struct figlet_font figlet_font;
+
+typedef struct figlet_options {
+  int smushmode;       /* SM_* bits, used according to smushoverride */
+  int smushoverride;   /* SMO_* */
+  int right2left;      /* 0: left-to-right, 1: right-to-left, -1: font */
+  int justification;   /* 0: left, 1: center, 2: right, -1: font */
+  int paragraphflag;   /* true to join lines into paragraphs */
+  int deutschflag;     /* true to map [\]{|}~ to German letters */
+  int outputwidth;     /* width of output device in columns */
+  } figlet_options;
+
+/* What a font holds, as figlet_font_info reports it */
+typedef struct figlet_fontinfo {
+  int chars;           /* characters */
+  int rows;            /* rows of all the characters */
+  int uniquerows;      /* distinct rows: only these are stored */
+  size_t cells;        /* cells of all the rows, with their ends */
+  size_t uniquecells;  /* cells of the distinct rows */
+  size_t size;         /* bytes the font takes */
+  } figlet_fontinfo;
+
+/* Output callback: returns nonzero to abort rendering */
+typedef int (*figlet_outfn)(void *userdata, const char *buf, size_t len);
+
+/* Input callback: returns the next byte of input, or EOF */
+typedef int (*figlet_getcfn)(void *arg);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+figlet_font    *figlet_font_load(const char *fontdir, const char *fontname,
+                  int *errp);
+figlet_font    *figlet_font_load_lazy(const char *fontdir,
+                  const char *fontname, int *errp);
+figlet_font    *figlet_font_load_cached(const char *fontdir,
+                  const char *fontname, const char *cachedir, int *errp);
+figlet_font    *figlet_font_ref(figlet_font *font);
+void            figlet_font_unref(figlet_font *font);
+void            figlet_font_info(const figlet_font *font,
+                  figlet_fontinfo *info);
+
+void            figlet_defaults(figlet_options *opts);
+figlet_context *figlet_new(const figlet_options *opts);
+void            figlet_free(figlet_context *ctx);
+void            figlet_set_options(figlet_context *ctx,
+                  const figlet_options *opts);
+void            figlet_set_font(figlet_context *ctx, figlet_font *font);
+void            figlet_set_userdata(figlet_context *ctx, void *userdata);
+
+int             figlet_load_font(figlet_context *ctx, const char *fontdir,
+                  const char *fontname);
+int             figlet_read_control(figlet_context *ctx, const char *fontdir,
+                  const char *controlname);
+
+int             figlet_render(figlet_context *ctx, const char *input,
+                  size_t len, figlet_outfn out);
+int             figlet_render_input(figlet_context *ctx, figlet_getcfn getbyte,
+                  void *arg, figlet_outfn out);
+int             figlet_render_fd(figlet_context *ctx, int fd,
+                  figlet_outfn out);
+int             figlet_render_path(figlet_context *ctx, const char *path,
+                  figlet_outfn out);
+int             figlet_render_argv(figlet_context *ctx, int argc,
+                  char *const argv[], figlet_outfn out);
+
+const char     *figlet_strerror(int err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
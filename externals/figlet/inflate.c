@@ -44,7 +44,7 @@
  * 3) Routines can be easily integrated into wide range of applications
  * 4) Routines are very portable, and use only ANSI C
  * 5) No #defines in inflate.h to conflict with external #defines
- * 6) No external routines need be called by these routines
+ * 6) No external routines need be called by these routines, but memcpy
  * 7) Buffers are owned by the calling routine
  * 8) No static non-constant variables are allowed
  */
@@ -54,11 +54,15 @@
  * 0 or more calls to (*putbuffer_ptr).  Before InflatePutBuffer
  * returns, it will have output as much uncompressed data as
  * is possible.
+ *
+ * InflatePutBufferSome is the same, except that (*putbuffer_ptr)
+ * may return -1 to hold on to the buffer it was given, which is
+ * part of the output window.  Then InflatePutBufferSome returns
+ * at once, with the window left as it is until it is next called.
  */
 
-#ifdef MEMCPY
-#include <mem.h>
-#endif
+#include <limits.h>
+#include <string.h>
 
 #include "inflate.h"
 
@@ -94,6 +98,33 @@
 #define BUFFERMASK 0x3fff
 #endif
 
+/*
+ * The fast decoder runs while there are at least FASTIN bytes of
+ * input in the buffer and room for a longest match in the window,
+ * and decodes codes of up to FASTLBITS and FASTDBITS bits with one
+ * lookup each.
+ */
+
+#ifndef FASTINFLATE
+#define FASTINFLATE TRUE
+#endif
+
+#ifndef FASTIN
+#define FASTIN 16
+#endif
+
+#ifndef FASTOUT
+#define FASTOUT 258
+#endif
+
+#ifndef FASTLBITS
+#define FASTLBITS 10
+#endif
+
+#ifndef FASTDBITS
+#define FASTDBITS 8
+#endif
+
 #ifndef INFLATESTATETYPE
 #define INFLATESTATETYPE   0xabcdabcdL
 #endif
@@ -126,6 +157,8 @@ struct InflateState {
   struct huft   *td;                         /* distance decoder table     */
   int            bl;                         /* bits decoded by tl         */
   int            bd;                         /* bits decoded by td         */
+  ush            fastl[1 << FASTLBITS];      /* flat literal/length table  */
+  ush            fastd[1 << FASTDBITS];      /* flat distance table        */
 
   /* State for decoding stored data */
   unsigned int   storelength;
@@ -140,6 +173,10 @@ struct InflateState {
   unsigned int   bs;                         /* input buffer size          */
   unsigned char  buffer[BUFFERSIZE];         /* input buffer data          */
 
+  /* Input not yet taken from InflatePutBuffer's caller */
+  unsigned char *inp;                        /* caller's input left        */
+  long           inplen;                     /* length of caller's input   */
+
   /* Storage for try/catch */
   ulg            catch_bb;                   /* bit buffer                 */
   unsigned int   catch_bk;                   /* bits in bit buffer         */
@@ -151,6 +188,11 @@ struct InflateState {
   unsigned int   wf;                         /* output window flush-from   */
   unsigned char  window[WINDOWSIZE];         /* output window data         */
 
+  /* State for holding the window for the application */
+  int            held;                       /* putbuffer holds window     */
+  unsigned int   copyn;                      /* length of copy held up     */
+  unsigned int   copyd;                      /* window index it copies     */
+
   /* Application state */
   void          *AppState;                   /* opaque ptr for callout     */
 
@@ -248,20 +290,80 @@ struct InflateState {
   k -= (n);         \
 }
 
+/*
+ * Macros for filling the bit buffer in the fast decoder, which
+ * knows there is enough input that it need not check for the end
+ * of it.  Where ulg has 64 bits, FASTFILL loads a word at a time
+ * and leaves at least 56 bits in b (and the bits above k hold the
+ * next input too, so FASTDONE clears them for NEEDBITS), which is
+ * enough for a length and distance.  Otherwise it loads a byte at a
+ * time, and FASTFILL32 tops b up again before each part that a
+ * 32-bit b cannot hold all at once.
+ */
+
+#if ULONG_MAX > 0xffffffffUL
+
+#define GETWORD(p)                                         \
+  ( ((ulg) (p)[0]      ) | ((ulg) (p)[1] <<  8) |          \
+    ((ulg) (p)[2] << 16) | ((ulg) (p)[3] << 24) |          \
+    ((ulg) (p)[4] << 32) | ((ulg) (p)[5] << 40) |          \
+    ((ulg) (p)[6] << 48) | ((ulg) (p)[7] << 56)   )
+
+#define FASTFILL          \
+{                         \
+  b |= GETWORD(in) << k;  \
+  in += (63 - k) >> 3;    \
+  k |= 56;                \
+}
+
+#define FASTFILL32
+
+#define FASTDONE           \
+{                          \
+  b &= ((ulg) 1 << k) - 1; \
+}
+
+#else
+
+#define FASTFILL                   \
+{                                  \
+  while (k <= 24)                  \
+  {                                \
+    b |= ((ulg) *in++) << k;       \
+    k += 8;                        \
+  }                                \
+}
+
+#define FASTFILL32 FASTFILL
+
+#define FASTDONE
+
+#endif
+
 /*
  * Macro for flushing the output window to the putbuffer callout.
  *
  * Note that the window is always flushed when it fills to 32K,
- * and before returning to the application.
+ * and before returning to the application.  If the callout holds
+ * on to the window, is->held is set, and the caller must return
+ * without writing to the window again.
  */
 
 #define FLUSHWINDOW(w, now)                               \
 if ((now && (is->wp > is->wf)) || ((w) >= WINDOWSIZE))    \
 {                                                         \
   is->wp = (w);                                           \
-  if ((*(is->putbuffer_ptr))                              \
-        (is->AppState, is->window+is->wf, is->wp-is->wf)) \
-    ERROREXIT(is);                                        \
+  switch ((*(is->putbuffer_ptr))                          \
+            (is->AppState, is->window+is->wf, is->wp-is->wf)) \
+  {                                                       \
+    case 0:                                               \
+      break;                                              \
+    case -1:                                              \
+      is->held = TRUE;                                    \
+      break;                                              \
+    default:                                              \
+      ERROREXIT(is);                                      \
+  }                                                       \
   is->wp &= WINDOWMASK;                                   \
   is->wf  = is->wp;                                       \
   (w) = is->wp;                                           \
@@ -674,6 +776,63 @@ static int huft_build(
   return y != 0 && g != 1;
 }
 
+/*
+ * Given the same code lengths as huft_build(), fill in the flat table
+ * of 1 << bits entries that inflate_fast() looks codes up in first.
+ * An entry has the length of the code that its index starts with in
+ * its top four bits, and the value of the code below.  It is zero if
+ * that code is longer than bits, or its value is s or more, or there
+ * is no such code, which leaves it to be decoded from the huft_build()
+ * tables as usual.  The lengths must have passed huft_build().
+ */
+
+static void fast_build(
+  ush *f,                  /* flat table to fill in */
+  int bits,                /* bits decoded by f */
+  unsigned *b,             /* code lengths in bits (all assumed <= BMAX) */
+  unsigned n,              /* number of codes (assumed <= N_MAX) */
+  unsigned s               /* values from s on are left to huft */
+)
+{
+  unsigned c[BMAX+1];           /* bit length count table */
+  unsigned x[BMAX+1];           /* next code of each length */
+  unsigned i;                   /* counter, current value */
+  unsigned j;                   /* counter */
+  unsigned k;                   /* length of current code */
+  unsigned r;                   /* current code, bit-reversed */
+  unsigned z;                   /* number of entries in f */
+
+  /* count the codes of each length, as huft_build() does */
+  for (i = 0; i <= BMAX; i++)
+    c[i] = 0;
+  for (i = 0; i < n; i++)
+    c[b[i]]++;
+  c[0] = 0;
+
+  /* the first code of each length, in the order huft_build() uses */
+  x[1] = 0;
+  for (i = 1; i < BMAX; i++)
+    x[i+1] = (x[i] + c[i]) << 1;
+
+  z = 1 << bits;
+  for (i = 0; i < z; i++)
+    f[i] = 0;
+
+  /* fill every entry that starts with each short enough code */
+  for (i = 0; i < n; i++)
+  {
+    if ((k = b[i]) == 0)
+      continue;
+    j = x[k]++;
+    if (k > (unsigned)bits || i >= s)
+      continue;
+    for (r = 0; k--; j >>= 1)
+      r = (r << 1) | (j & 1);
+    for (k = b[i]; r < z; r += 1 << k)
+      f[r] = (ush)((k << 12) | i);
+  }
+}
+
 /*
  * inflate (decompress) the codes in a stored (uncompressed) block.
  * Return an error code or zero if it all goes ok.
@@ -686,6 +845,7 @@ static int inflate_stored(
   ulg b;                /* bit buffer */
   unsigned k;           /* number of bits in bit buffer */
   unsigned w;           /* current window position */
+  unsigned n;           /* number of bytes to copy at once */
 
   /* make local copies of state */
   b = is->bb;           /* initialize bit buffer */
@@ -698,11 +858,27 @@ static int inflate_stored(
 
   while (is->storelength > 0)  /* do until end of block */
   {
-    NEEDBITS(8)
-    is->window[w++] = (uch) b;
-    DUMPBITS(8)
+    if (k > 0 || is->bs == 0)  /* the bytes already in b, one at a time */
+    {
+      NEEDBITS(8)
+      is->window[w++] = (uch) b;
+      DUMPBITS(8)
+      is->storelength--;
+    }
+    else                       /* then as many as can be copied at once */
+    {
+      n = BUFFERSIZE - (is->bp & BUFFERMASK);
+      if (n > is->bs) n = is->bs;
+      if (n > WINDOWSIZE - w) n = WINDOWSIZE - w;
+      if (n > is->storelength) n = is->storelength;
+      memcpy(is->window + w, is->buffer + (is->bp & BUFFERMASK), n);
+      is->bs -= n;
+      is->bp += n;
+      w      += n;
+      is->storelength -= n;
+    }
     FLUSHWINDOW(w, FALSE);
-    is->storelength--;
+    if (is->held) break;
   }
 
   cleanup:
@@ -718,6 +894,215 @@ static int inflate_stored(
     return 0;
 }
 
+/*
+ * Inflate codes quickly while there is input enough in the buffer (or
+ * the caller's) for any code, and room enough in the window for any
+ * match, so that neither needs checking for each code.  Codes are
+ * looked up in the flat tables, falling back to tl and td for the
+ * longer ones, and matches are copied eight bytes at a time.  Returns
+ * -1 once there is too little input or room left, for inflate_codes()
+ * to carry on with, 0 at the end of the block, or 1 on an error.
+ */
+
+static int inflate_fast(
+  struct InflateState *is, /* Inflate state */
+  struct huft *tl,         /* literal/length decoder table */
+  struct huft *td,         /* distance decoder table */
+  int bl,                  /* number of bits decoded by tl[] */
+  int bd                   /* number of bits decoded by td[] */
+)
+{
+  unsigned e;           /* table entry flag/number of extra bits */
+  unsigned n, d;        /* length and distance for copy */
+  unsigned c;           /* flat table entry */
+  unsigned w;           /* current window position */
+  struct huft *t;       /* pointer to table entry */
+  uch *in;              /* next input byte not yet in b */
+  uch *inlast;          /* last place in can start a code from */
+  uch *start;           /* where in started from */
+  int direct;           /* in is in the caller's buffer */
+  ulg b;                /* bit buffer */
+  unsigned k;           /* number of bits in bit buffer */
+  int ret;              /* return code */
+
+  if (is->wp >= WINDOWSIZE - FASTOUT)
+    return -1;
+
+  /* make local copies of state */
+  b = is->bb;           /* initialize bit buffer */
+  k = is->bk;           /* initialize bit count */
+  w = is->wp;           /* initialize window position */
+  ret = -1;
+
+  /*
+   * Once what is left in the input buffer fits in b, take it, and go
+   * on with the caller's input straight from the caller's buffer, if
+   * there is enough of it.  Otherwise only the part of the input
+   * buffer before it wraps can be used.
+   */
+  direct = (is->bs < FASTIN) && (is->inplen >= FASTIN) &&
+           (k + 8 * is->bs <= 8 * sizeof(ulg) - 8);
+  if (direct)
+  {
+    while (is->bs > 0)
+    {
+      b |= ((ulg) (is->buffer[is->bp & BUFFERMASK])) << k;
+      is->bs--;
+      is->bp++;
+      k += 8;
+    }
+    start = in = is->inp;
+    inlast = in + (is->inplen - FASTIN);
+  }
+  else
+  {
+    n = BUFFERSIZE - (is->bp & BUFFERMASK);
+    if (n > is->bs)
+      n = is->bs;
+    if (n < FASTIN)
+      return -1;
+    start = in = is->buffer + (is->bp & BUFFERMASK);
+    inlast = in + (n - FASTIN);
+  }
+
+  do
+  {
+    /* get a literal/length code */
+    FASTFILL
+    if ((c = is->fastl[(unsigned)b & ((1 << FASTLBITS) - 1)]) != 0)
+    {
+      DUMPBITS(c >> 12)
+      c &= 0xfff;
+      if (c < 256)                /* it's a literal */
+      {
+        is->window[w++] = (uch)c;
+        continue;
+      }
+      if (c == 256)               /* it's an EOB */
+      {
+        ret = 0;
+        break;
+      }
+      e = cplext[c - 257];
+      n = cplens[c - 257];
+    }
+    else
+    {
+      if ((e = (t = tl + ((unsigned)b & mask_bits[bl]))->e) > 16)
+        do {
+          if (e == 99)
+            return 1;
+          DUMPBITS(t->b)
+          e -= 16;
+        } while ((e = (t = t->v.t + ((unsigned)b & mask_bits[e]))->e) > 16);
+      DUMPBITS(t->b)
+
+      if (e == 16)                /* it's a literal */
+      {
+        is->window[w++] = (uch)t->v.n;
+        continue;
+      }
+      if (e == 15)                /* it's an EOB */
+      {
+        ret = 0;
+        break;
+      }
+      n = t->v.n;
+    }
+
+    /* it's a length, so get the length of block to copy */
+    n += (unsigned)b & mask_bits[e];
+    DUMPBITS(e)
+
+    /* decode distance of block to copy */
+    FASTFILL32
+    if ((c = is->fastd[(unsigned)b & ((1 << FASTDBITS) - 1)]) != 0)
+    {
+      DUMPBITS(c >> 12)
+      e = cpdext[c & 0xfff];
+      d = cpdist[c & 0xfff];
+    }
+    else
+    {
+      if ((e = (t = td + ((unsigned)b & mask_bits[bd]))->e) > 16)
+        do {
+          if (e == 99)
+            return 1;
+          DUMPBITS(t->b)
+          e -= 16;
+        } while ((e = (t = t->v.t + ((unsigned)b & mask_bits[e]))->e) > 16);
+      DUMPBITS(t->b)
+      d = t->v.n;
+    }
+    FASTFILL32
+    d += (unsigned)b & mask_bits[e];
+    DUMPBITS(e)
+
+    /* do the copy */
+    if (d > w)                    /* from the end of the window */
+    {
+      d = w - d + WINDOWSIZE;
+      do {
+        is->window[w++] = is->window[d++ & WINDOWMASK];
+      } while (--n);
+    }
+    else
+    {
+      uch *out = is->window + w;  /* where to copy to */
+      uch *last;                  /* last place for an 8-byte copy */
+
+      w += n;
+
+      /* a short distance repeats, so copy from a whole repeat back */
+      if (d < 8)
+      {
+        for (e = d; e < 8; e += d)
+          ;
+        for (c = e - d; c && n; c--, n--)
+        {
+          *out = *(out - d);
+          out++;
+        }
+        d = e;
+      }
+      if (n >= 8)
+      {
+        last = out + n - 8;
+        do {
+          memcpy(out, out - d, 8);
+          out += 8;
+        } while (out < last);
+        memcpy(last, last - d, 8);
+      }
+      else
+        while (n--)
+        {
+          *out = *(out - d);
+          out++;
+        }
+    }
+  }
+  while ((in <= inlast) && (w < WINDOWSIZE - FASTOUT));
+
+  /* restore the state from the locals */
+  FASTDONE
+  is->bb = b;              /* restore bit buffer */
+  is->bk = k;              /* restore bit count */
+  is->wp = w;              /* restore window pointer */
+  if (direct)              /* count the input used */
+  {
+    is->inp    += in - start;
+    is->inplen -= in - start;
+  }
+  else
+  {
+    is->bp += in - start;
+    is->bs -= in - start;
+  }
+
+  return ret;
+}
+
 static int inflate_codes(
   struct InflateState *is, /* Inflate state */
   struct huft *tl,         /* literal/length decoder table */
@@ -738,12 +1123,62 @@ static int inflate_codes(
   b = is->bb;           /* initialize bit buffer */
   k = is->bk;           /* initialize bit count */
   w = is->wp;           /* initialize window position */
+  n = is->copyn;        /* a copy held up by the application, if any */
+  d = is->copyd;
+  is->copyn = 0;
 
   /* inflate the coded data */
   ml = mask_bits[bl];           /* precompute masks for speed */
   md = mask_bits[bd];
   for (;;)                      /* do until end of block */
   {
+    /* do the copy a length and distance call for */
+    while (n)
+    {
+      n -= (e = ((e = WINDOWSIZE - ((d &= WINDOWMASK) > w ? d : w)) > n)
+                ? n : e
+           );
+      if (w - d >= e)         /* (this test assumes unsigned comparison) */
+      {
+        memcpy(is->window + w, is->window + d, e);
+        w += e;
+        d += e;
+      }
+      else                      /* do it slow to avoid memcpy() overlap */
+        do {
+          is->window[w++] = is->window[d++];
+        } while (--e);
+      FLUSHWINDOW(w, FALSE);
+      if (is->held)
+      {
+        is->copyn = n;     /* finish the copy next time */
+        is->copyd = d;
+        is->bb = b;
+        is->bk = k;
+        is->wp = w;
+        return -1;
+      }
+    }
+
+    /* go fast while there is input and room enough */
+    if (FASTINFLATE && ((is->bs >= FASTIN) || (is->inplen >= FASTIN)) &&
+        (w < WINDOWSIZE - FASTOUT))
+    {
+      int ret;
+
+      is->bb = b;
+      is->bk = k;
+      is->wp = w;
+      ret = inflate_fast(is, tl, td, bl, bd);
+      b = is->bb;
+      k = is->bk;
+      w = is->wp;
+      if (ret > 0)
+        return ret;
+      if (ret == 0)
+        break;
+    }
+
     TRY
     {
       NEEDBITS((unsigned)bl)
@@ -761,6 +1196,13 @@ static int inflate_codes(
       {
         is->window[w++] = (uch)t->v.n;
         FLUSHWINDOW(w, FALSE);
+        if (is->held)
+        {
+          is->bb = b;
+          is->bk = k;
+          is->wp = w;
+          return -1;
+        }
       }
       else if (e == 15)           /* it's an EOB */
       {
@@ -787,26 +1229,6 @@ static int inflate_codes(
         NEEDBITS(e)
         d = w - t->v.n - ((unsigned)b & mask_bits[e]);
         DUMPBITS(e)
-
-        /* do the copy */
-        do {
-          n -= (e = ((e = WINDOWSIZE - ((d &= WINDOWMASK) > w ? d : w)) > n)
-                    ? n : e
-               );
-#if defined(MEMCPY)
-          if (w - d >= e)         /* (this test assumes unsigned comparison) */
-          {
-            memcpy(is->window + w, is->window + d, e);
-            w += e;
-            d += e;
-          }
-          else                      /* do it slow to avoid memcpy() overlap */
-#endif /* MEMCPY */
-            do {
-              is->window[w++] = is->window[d++];
-            } while (--e);
-          FLUSHWINDOW(w, FALSE);
-        } while (n);
       }
     }
     CATCH_BEGIN
@@ -898,6 +1320,7 @@ static int inflate_fixed_setup(
   bl = 7;
   if ((i = huft_build(is, l, 288, 257, cplens, cplext, &tl, &bl)) != 0)
     return i;
+  fast_build(is->fastl, FASTLBITS, l, 288, 286);
 
   /* set up distance table */
   for (i = 0; i < 30; i++)      /* make an incomplete code set */
@@ -908,6 +1331,7 @@ static int inflate_fixed_setup(
     huft_free(is, tl);
     return i;
   }
+  fast_build(is->fastd, FASTDBITS, l, 30, 30);
 
   /* Save inflate state for this block */
   is->tl = tl;
@@ -1063,11 +1487,16 @@ static int inflate_dynamic_setup(
   bd = dbits;
   if ((i = huft_build(is, ll + nl, nd, 0, cpdist, cpdext, &td, &bd)) != 0)
   {
-    if (i == 1) {
-      /* incomplete distance tree */
 #ifdef PKZIP_BUG_WORKAROUND
+    /* only an incomplete tree is let through, not a bad or missing one */
+    if (i > 1)
+    {
+      huft_free(is, tl);
+      return i;
     }
 #else
+    if (i == 1) {
+      /* incomplete distance tree */
       huft_free(is, td);
     }
     huft_free(is, tl);
@@ -1075,6 +1504,10 @@ static int inflate_dynamic_setup(
 #endif
   }
 
+  /* set up the flat tables for inflate_fast() */
+  fast_build(is->fastl, FASTLBITS, ll, nl, 286);
+  fast_build(is->fastd, FASTDBITS, ll + nl, nd, 30);
+
   /* Save inflate state for this block */
   is->tl = tl;
   is->td = td;
@@ -1114,9 +1547,16 @@ void *InflateInitialize(                      /* returns InflateState       */
   is->bp               = 0;
   is->bs               = 0;
 
+  is->inp              = NULL;
+  is->inplen           = 0;
+
   is->wp               = 0;
   is->wf               = 0;
 
+  is->held             = FALSE;
+  is->copyn            = 0;
+  is->copyd            = 0;
+
   is->state            = -1;
   is->lastblock        = FALSE;
 
@@ -1132,44 +1572,53 @@ void *InflateInitialize(                      /* returns InflateState       */
   return is;
 }
 
-/* Call-in routine to put a buffer into inflate decompression */
-int InflatePutBuffer(                         /* returns 0 on success       */
-  void *InflateState,                         /* opaque ptr from Initialize */
-  unsigned char *buffer,                      /* buffer to put              */
-  long length                                 /* length of buffer           */
+/*
+ * Put as much of a buffer as possible into inflate decompression, and
+ * count what was taken.  Stops early if putbuffer holds on to the window.
+ */
+
+static int inflate_put(    /* returns 0 on success */
+  struct InflateState *is, /* Inflate state */
+  unsigned char *buffer,   /* buffer to put */
+  long length,             /* length of buffer */
+  long *taken              /* incremented by the length taken */
 )
 {
-  struct InflateState *is;
-
   int beginstate;
 
-  /* Get (and check) the InflateState structure */
-  is = (struct InflateState *) InflateState;
-  if (!is || (is->runtimetypeid1 != INFLATESTATETYPE)
-          || (is->runtimetypeid2 != INFLATESTATETYPE)) return TRUE;
-  if (is->errorencountered) return TRUE;
-
   do
   {
-    int size, i;
-    
+    int size, i, n;
 
     if ((is->state == -1) && (is->lastblock)) break;
 
     /* Save the beginning state */
     beginstate = is->state;
 
-    /* Push as much as possible into input buffer */
+    /*
+     * Push as much as possible into input buffer, except while codes
+     * are decoded and it is all but empty.  Then inflate_fast() takes
+     * the input from the caller's buffer instead, and it is pushed only
+     * a little at a time, to decode the codes at the end of the window.
+     */
     size = BUFFERSIZE - is->bs;
+    if (FASTINFLATE && ((is->state == 11) || (is->state == 12)) &&
+        (is->bs < FASTIN) && (length >= FASTIN))
+      size = (is->wp < WINDOWSIZE - FASTOUT) ? 0 : FASTIN;
     if (size > length) size = (int) length;
-    i = is->bp + is->bs;
 
-    while (size-- > 0)
+    /* in at most two pieces, as the input buffer wraps */
+    while (size > 0)
     {
-      is->buffer[i++ & BUFFERMASK] = *buffer;
-      is->bs++;
-      buffer++;
-      length--;
+      i = (is->bp + is->bs) & BUFFERMASK;
+      n = BUFFERSIZE - i;
+      if (n > size) n = size;
+      memcpy(is->buffer + i, buffer, n);
+      is->bs  += n;
+      buffer  += n;
+      length  -= n;
+      size    -= n;
+      *taken  += n;
     }
 
     /* Process some more data */
@@ -1266,7 +1715,14 @@ int InflatePutBuffer(                         /* returns 0 on success       */
     {
       int ret;
 
+      is->inp    = buffer;
+      is->inplen = length;
       ret = inflate_codes(is, is->tl, is->td, is->bl, is->bd);
+      *taken += is->inp - buffer;
+      length -= is->inp - buffer;
+      buffer  = is->inp;
+      is->inp    = NULL;
+      is->inplen = 0;
 
       if (ret > 0)
         ERROREXIT(is);
@@ -1283,6 +1739,9 @@ int InflatePutBuffer(                         /* returns 0 on success       */
     {
       ERROREXIT(is);
     }
+
+    /* Stop while the application holds the window */
+    if (is->held) return FALSE;
   }
   while (length || (is->state != beginstate));
   
@@ -1291,6 +1750,43 @@ int InflatePutBuffer(                         /* returns 0 on success       */
   return is->errorencountered;
 }
 
+/* Call-in routine to put a buffer into inflate decompression */
+int InflatePutBuffer(                         /* returns 0 on success       */
+  void *InflateState,                         /* opaque ptr from Initialize */
+  unsigned char *buffer,                      /* buffer to put              */
+  long length                                 /* length of buffer           */
+)
+{
+  return InflatePutBufferSome(InflateState, buffer, length) < 0;
+}
+
+/* Call-in routine to put a buffer into inflate decompression, */
+/* till (*putbuffer_ptr) holds on to the window                */
+long InflatePutBufferSome(                    /* returns length taken or -1 */
+  void *InflateState,                         /* opaque ptr from Initialize */
+  unsigned char *buffer,                      /* buffer to put              */
+  long length                                 /* length of buffer           */
+)
+{
+  struct InflateState *is;
+
+  long taken;
+
+  /* Get (and check) the InflateState structure */
+  is = (struct InflateState *) InflateState;
+  if (!is || (is->runtimetypeid1 != INFLATESTATETYPE)
+          || (is->runtimetypeid2 != INFLATESTATETYPE)) return -1;
+  if (is->errorencountered) return -1;
+
+  /* The application is done with the window it held, if any */
+  is->held = FALSE;
+
+  taken = 0;
+  if (inflate_put(is, buffer, length, &taken)) return -1;
+
+  return taken;
+}
+
 /* Routine to terminate inflate decompression */
 int InflateTerminate(                         /* returns 0 on success       */
   void *InflateState                          /* opaque ptr from Initialize */
@@ -1311,6 +1807,14 @@ int InflateTerminate(                         /* returns 0 on success       */
                              || (is->state != -1)
                              || (!is->lastblock);
 
+  /* free the decoding tables, if stopped in the middle of a block */
+  if ((is->state == 11) ||
+      (is->state == 12)    )
+  {
+    huft_free(is, is->tl);
+    huft_free(is, is->td);
+  }
+
   /* save the address of the free routine */
   free_ptr = is->free_ptr;
 
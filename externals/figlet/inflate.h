@@ -50,6 +50,15 @@
  * this behaviour may change in the future.  Before InflatePutBuffer
  * returns, it will have output as much uncompressed data as
  * is possible.
+ *
+ * InflatePutBufferSome is the same, except that (*putbuffer_ptr)
+ * may return -1 to hold on to the buffer it was given, which is
+ * part of inflate's window, instead of copying it.  Then
+ * InflatePutBufferSome returns at once, with how much of its
+ * buffer it took, and leaves the window alone till it is called
+ * again (with the rest of the buffer, or with none to go on with
+ * what it already took).  Each call makes at most one call to
+ * (*putbuffer_ptr) that returns -1.
  */
 
 #ifndef __INFLATE_H
@@ -78,6 +87,14 @@ int InflatePutBuffer(                         /* returns 0 on success       */
   long length                                 /* length of buffer           */
 );
 
+/* Call-in routine to put a buffer into inflate decompression, */
+/* till (*putbuffer_ptr) holds on to the window                */
+long InflatePutBufferSome(                    /* returns length taken or -1 */
+  void *InflateState,                         /* opaque ptr from Initialize */
+  unsigned char *buffer,                      /* buffer to put              */
+  long length                                 /* length of buffer           */
+);
+
 /* Routine to terminate inflate decompression */
 int InflateTerminate(                         /* returns 0 on success       */
   void *InflateState                          /* opaque ptr from Initialize */
@@ -0,0 +1,2934 @@
+/****************************************************************************
+
+  FIGlet Copyright 1991, 1993, 1994 Glenn Chappell and Ian Chai
+  FIGlet Copyright 1996, 1997, 1998, 1999, 2000, 2001 John Cowan
+  FIGlet Copyright 2002 Christiaan Keet
+  FIGlet Copyright 2011, 2012 Claudio Matsuoka
+  Portions written by Paul Burton and Christiaan Keet
+  Internet: <info@figlet.org>
+  FIGlet, along with the various FIGlet fonts and documentation, is
+    copyrighted under the provisions of the New BSD License (3-clause)
+    (as listed in the file "LICENSE" which is included in this package)
+****************************************************************************/
+
+/*
+ * libfiglet.c - the FIGlet rendering engine
+ *
+ * This is the control file, input decoding and line layout code that
+ * used to live in figlet.c, with every global moved into struct
+ * figlet_context.  Fonts are loaded by figfont.c.  See figlet.h for
+ * the interface.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "figint.h"
+#include "utf8.h"
+
+#ifdef FIG_MMAP
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#else
+#include <io.h>
+#endif
+
+
+/****************************************************************************
+
+  Types dealing with command file storage
+
+****************************************************************************/
+
+typedef struct cm {
+  int thecommand;
+  inchr rangelo;
+  inchr rangehi;
+  inchr offset;
+  struct cm *next;
+  } comnode;
+
+
+/****************************************************************************
+
+  The mapping the control file commands add up to
+
+  Every chain of translate commands and freezes comes down to adding
+  an offset that depends only on which range the input character is
+  in.  The mapping is kept as the disjoint segments of the inchr range
+  with their offsets, sorted, and for the chars below MAPDIRECT, also
+  as a table of what each one maps to.
+
+****************************************************************************/
+
+typedef struct {
+  inchr lo;
+  inchr hi;
+  inchr offset;
+  } mapseg;
+
+#define MAPDIRECT 0x10000  /* chars mapped by table lookup */
+
+#define INBUFSIZE 65536  /* bytes read from an input stream at a time */
+#define UTF8BUFSIZE 256  /* UTF-8 input chars decoded at a time */
+#define DECBUFSIZE 256   /* other input chars decoded at a time */
+
+
+/****************************************************************************
+
+  Edge profile of one row of the output line
+
+  Only the edge that the next character is smushed into is kept up to
+  date: the right edge when printing left-to-right, the left edge when
+  printing right-to-left.
+
+****************************************************************************/
+
+typedef struct {
+  int len;    /* STRLEN(outputline[row]) */
+  int left;   /* number of leading ' ' (right-to-left only) */
+  int right;  /* index of the last char other than ' ', or -1 */
+              /* (left-to-right only) */
+  } lineedge;
+
+
+#define SMUSHCHARS 256  /* chars below this are smushed by table lookup */
+
+#ifdef TLF_FONTS
+#define CHARCODE(c) ((unsigned long)(c))
+#else
+#define CHARCODE(c) ((unsigned char)(c))
+#endif
+
+
+/****************************************************************************
+
+  figlet_context
+
+  Everything needed to render: a reference to a (shared) font, the
+  options, the control file commands and input decoding state, and the
+  line buffers.
+
+****************************************************************************/
+
+struct figlet_context {
+
+  /* Options as given by the caller */
+  figlet_options opts;
+
+  /* Font, shared with other contexts and never modified */
+  figlet_font *font;
+
+  /* Effective options, resolved against the font at render time */
+  int smushmode;
+  int right2left;
+  int justification;
+  int outputwidth;
+
+  /* Control file commands */
+  comnode *commandlist,**commandlistend;
+
+  /* The commands built into one mapping, when they have changed */
+  int mapstale;          /* true if commands were added since */
+  mapseg *mapsegs;       /* Alloc'd mapseg mapsegs[nmapsegs]; */
+  int nmapsegs;          /* 0 if the commands map nothing */
+  inchr *mapdirect;      /* Alloc'd inchr mapdirect[MAPDIRECT]; */
+                         /* or NULL if nmapsegs is 0 */
+
+  /* Input decoding state set up by control files */
+  int multibyte;
+  int gndbl0[4];
+  inchr gn0[4];
+  int gl0,gr0;
+
+  /* Input decoding state while rendering */
+  int gndbl[4]; /* gndbl[n] is true if Gn is double-byte */
+  inchr gn[4]; /* Gn character sets: ASCII, Latin-1, none, none */
+  int gl; /* 0-3 specifies left-half Gn character set */
+  int gr; /* 0-3 specifies right-half Gn character set */
+  int ss; /* true if GL and GR are single-shifted: they go back */
+  int ssgl,ssgr; /* to ssgl and ssgr after the next char */
+  int decstate;  /* DS_*: where the decoder is in a sequence */
+  int declead;   /* the byte the rest of the sequence depends on */
+  inchr *decbuf; /* Alloc'd inchr decbuf[decsize]; chars decoded ahead */
+  int decsize;   /* or pushed back: what is left is decptr to decend */
+  int decptr,decend;
+  utf8_cp_t utf8buf[UTF8BUFSIZE];  /* UTF-8 input decoded ahead: */
+  utf8_cp_t *utf8ptr,*utf8end;     /* what is left is utf8ptr to utf8end */
+
+  /* Input line */
+  inchr *inchrline;  /* Alloc'd inchr inchrline[inchrlinelenlimit+1]; */
+                     /* Note: not null-terminated. */
+  int inchrlinelen,inchrlinelenlimit;
+
+  /* Output line */
+  const int *currchar;   /* where each row of it starts in currcells */
+  const fcedge *curredge;
+  const void *currcells; /* narrowchr cells if currnarrow, else outchr */
+  int currnarrow;
+  int currcharwidth;
+  int previouscharwidth;
+  outchr **outlinebuf;   /* Alloc'd char outlinebuf[charheight][outlinelenlimit+1]; */
+  outchr **outputline;   /* Alloc'd; outputline[row] is the first char of */
+                         /* the row: the start of outlinebuf[row], or when */
+                         /* printing right-to-left, len chars before its */
+                         /* end, so the row grows leftward */
+  outchr *outlinescratch; /* Alloc'd char outlinescratch[outlinelenlimit+1]; */
+  lineedge *outlineedge; /* Alloc'd lineedge outlineedge[charheight]; */
+  int outlinelen;
+  int outlinelenlimit;
+  int outlinerows;       /* charheight outputline was allocated for */
+
+  /* Output line as it was before the space that made the last word */
+  /* break, which is where splitline breaks the line */
+  int ckinchrlinelen;    /* 0 if there is no word break */
+  int ckcurrcharwidth;
+  lineedge *ckedge;      /* Alloc'd lineedge ckedge[charheight]; */
+  outchr *ckedgech;      /* Alloc'd char ckedgech[charheight]; */
+                         /* the char at the edge of each row */
+
+  /* Smush table: smushtab[lch*SMUSHCHARS+rch] is smushrule(lch,rch)+1, */
+  /* or 0 if not worked out yet, for the smushtab* settings */
+  unsigned short *smushtab;
+  int smushtabmode;
+  int smushtabhardblank;
+  int smushtabr2l;
+
+  /* Input: the bytes not read yet are inptr to inend; when they run */
+  /* out, refill makes more available, or returns 0 at end of input, */
+  /* setting inerror too if it ended because reading failed */
+  const unsigned char *inptr,*inend;
+  int (*refill)(figlet_context *ctx);
+  int inerror;
+  unsigned char *inbuf;  /* Alloc'd unsigned char inbuf[INBUFSIZE]; */
+
+  /* Input sources refill reads from */
+  figlet_getcfn getbyte;
+  void *getbytearg;
+  int infd;
+  char *const *inargv;   /* words, as given to figlet_render_argv */
+  int inargc;
+  int inargi;            /* next word */
+  int inargsep;          /* true if the blank after a word is next */
+
+  /* Output */
+  figlet_outfn out;
+  void *userdata;
+  int outerror;
+  int nomem;             /* true if the render ran out of memory */
+  char *outbuf;          /* encoded output not yet handed to out */
+  size_t outbuflen;
+  size_t outbufsize;
+  };
+
+
+/****************************************************************************
+
+  skipws
+
+  Skips whitespace characters from a stream.
+
+****************************************************************************/
+
+static void skipws(ZFILE *fp)
+{
+  int c;
+  while (c=Zgetc(fp),isascii(c)&&isspace(c)) ;
+  Zungetc(c,fp);
+  }
+
+/****************************************************************************
+
+  readnum
+
+  Reads a number from a stream.  Accepts "0" prefix for octal and
+  "0x" or "0X" for hexadecimal.  Ignores leading whitespace.
+
+****************************************************************************/
+
+static void readnum(ZFILE *fp, inchr *nump)
+{
+  int acc = 0;
+  char *p;
+  int c;
+  int base;
+  int sign = 1;
+  char digits[] = "0123456789ABCDEF";
+
+  skipws(fp);
+  c = Zgetc(fp);
+  if (c=='-') {
+    sign = -1;
+    }
+  else {
+    Zungetc(c,fp);
+    }
+  c = Zgetc(fp);
+  if (c=='0') {
+     c = Zgetc(fp);
+     if (c=='x'||c=='X') {
+       base = 16;
+       }
+     else {
+       base = 8;
+       Zungetc(c,fp);
+       }
+    }
+  else {
+    base = 10;
+    Zungetc(c,fp);
+    }
+
+  while((c=Zgetc(fp))!=EOF) {
+    c=toupper(c);
+    p=strchr(digits,c);
+    if (!p) {
+      Zungetc(c,fp);
+      *nump = acc * sign;
+      return;
+      }
+    acc = acc*base+(p-digits);
+    }
+  *nump = acc * sign;
+  }
+
+/****************************************************************************
+
+  readTchar
+
+  Reads a control file "T" command character specification.
+
+  Character is a single byte, an escape sequence, or
+  an escaped numeric.
+
+****************************************************************************/
+
+static inchr readTchar(ZFILE *fp)
+{
+  inchr thechar;
+  char next;
+
+  thechar=Zgetc(fp);
+  if (thechar=='\n' || thechar=='\r') { /* Handle badly-formatted file */
+    Zungetc(thechar,fp);
+    return '\0';
+    }
+  if (thechar!='\\') return thechar;
+  next=Zgetc(fp);
+  switch(next) {
+    case 'a':
+      return 7;
+    case 'b':
+      return 8;
+    case 'e':
+      return 27;
+    case 'f':
+      return 12;
+    case 'n':
+      return 10;
+    case 'r':
+      return 13;
+    case 't':
+      return 9;
+    case 'v':
+      return 11;
+    default:
+      if (next=='-' || next=='x' || (next>='0' && next<='9')) {
+        Zungetc(next,fp);
+        readnum(fp,&thechar);
+        return thechar;
+        }
+      return next;
+    }
+}
+
+/****************************************************************************
+
+  charsetname
+
+  Get a Tchar representing a charset name, or 0 if none available.
+  Called in getcharset().
+
+****************************************************************************/
+
+static inchr charsetname(ZFILE *fp)
+{
+  inchr result;
+
+  result = readTchar(fp);
+  if (result == '\n' || result == '\r') {
+    result = 0;
+    Zungetc(result,fp);
+    }
+  return result;
+  }
+
+/****************************************************************************
+
+  charset
+
+  Processes "g[0123]" character set specifier
+  Called in readcontrol().
+
+****************************************************************************/
+
+static void charset(figlet_context *ctx, int n, ZFILE *controlfile)
+{
+  int ch;
+
+  skipws(controlfile);
+  if (Zgetc(controlfile) != '9') {
+    figskiptoeol(controlfile);
+    return;
+    }
+  ch = Zgetc(controlfile);
+  if (ch == '6') {
+     ctx->gn0[n] = 65536L * charsetname(controlfile) + 0x80;
+     ctx->gndbl0[n] = 0;
+     figskiptoeol(controlfile);
+     return;
+     }
+  if (ch != '4') {
+    figskiptoeol(controlfile);
+    return;
+    }
+  ch = Zgetc(controlfile);
+  if (ch == 'x') {
+     if (Zgetc(controlfile) != '9') {
+       figskiptoeol(controlfile);
+       return;
+       }
+     if (Zgetc(controlfile) != '4') {
+       figskiptoeol(controlfile);
+       return;
+       }
+     skipws(controlfile);
+     ctx->gn0[n] = 65536L * charsetname(controlfile);
+     ctx->gndbl0[n] = 1;
+     figskiptoeol(controlfile);
+     return;
+     }
+  Zungetc(ch, controlfile);
+  skipws(controlfile);
+  ctx->gn0[n] = 65536L * charsetname(controlfile);
+  ctx->gndbl0[n] = 0;
+  return;
+  }
+
+/****************************************************************************
+
+  addcommand
+
+  Appends a command to the end of the command list.  Returns false if
+  there is no memory.
+
+****************************************************************************/
+
+static int addcommand(figlet_context *ctx, int command, inchr rangelo,
+  inchr rangehi, inchr offset)
+{
+  if (((*ctx->commandlistend) = (comnode*)figalloc(sizeof(comnode)))==NULL) {
+    return 0;
+    }
+  (*ctx->commandlistend)->thecommand = command;
+  (*ctx->commandlistend)->rangelo = rangelo;
+  (*ctx->commandlistend)->rangehi = rangehi;
+  (*ctx->commandlistend)->offset = offset;
+  ctx->commandlistend = &(*ctx->commandlistend)->next;
+  (*ctx->commandlistend) = NULL;
+  ctx->mapstale = 1;
+  return 1;
+}
+
+/****************************************************************************
+
+  figlet_read_control
+
+  Allocates memory and reads in the given control file.  Returns
+  FIGLET_OK, FIGLET_ENOCTRL if there is no such file, or FIGLET_ENOMEM.
+
+****************************************************************************/
+
+int figlet_read_control(figlet_context *ctx, const char *fontdir,
+  const char *controlname)
+{
+  inchr firstch,lastch;
+  char dashcheck;
+  inchr offset;
+  int command,ok;
+  ZFILE *controlfile;
+
+  errno = 0;
+  controlfile = FIGopen(fontdir,controlname,CONTROLFILESUFFIX);
+
+  if (controlfile==NULL) {
+    return errno==ENOMEM ? FIGLET_ENOMEM : FIGLET_ENOCTRL;
+    }
+
+  ok = addcommand(ctx,0,0,0,0); /* Begin with a freeze command */
+
+  while(ok && (command=Zgetc(controlfile),command!=EOF)) {
+    switch (command) {
+      case 't': /* Translate */
+        skipws(controlfile);
+        firstch=readTchar(controlfile);
+        if ((dashcheck=Zgetc(controlfile))=='-') {
+          lastch=readTchar(controlfile);
+          }
+        else {
+          Zungetc(dashcheck,controlfile);
+          lastch=firstch;
+          }
+        skipws(controlfile);
+        offset=readTchar(controlfile)-firstch;
+        figskiptoeol(controlfile);
+        ok = addcommand(ctx,1,firstch,lastch,offset);
+        break;
+      case '0': case '1': case '2': case '3': case '4':
+      case '5': case '6': case '7': case '8': case '9':
+      case '-':
+                /* Mapping table entry */
+        Zungetc(command,controlfile);
+        readnum(controlfile,&firstch);
+        skipws(controlfile);
+        readnum(controlfile,&lastch);
+        offset=lastch-firstch;
+        lastch=firstch;
+        figskiptoeol(controlfile);
+        ok = addcommand(ctx,1,firstch,lastch,offset);
+        break;
+      case 'f': /* freeze */
+        figskiptoeol(controlfile);
+        ok = addcommand(ctx,0,0,0,0);
+        break;
+      case 'b': /* DBCS input mode */
+        ctx->multibyte = 1;
+        break;
+      case 'u': /* UTF-8 input mode */
+        ctx->multibyte = 2;
+        break;
+      case 'h': /* HZ input mode */
+        ctx->multibyte = 3;
+        break;
+      case 'j': /* Shift-JIS input mode */
+        ctx->multibyte = 4;
+        break;
+      case 'g': /* ISO 2022 character set choices */
+        ctx->multibyte = 0;
+        skipws(controlfile);
+        command=Zgetc(controlfile);
+        switch (command) {
+          case '0': /* define G0 charset */
+            charset(ctx, 0, controlfile);
+            break;
+          case '1': /* set G1 charset */
+            charset(ctx, 1, controlfile);
+            break;
+          case '2': /* set G2 charset */
+            charset(ctx, 2, controlfile);
+            break;
+          case '3': /* set G3 charset */
+            charset(ctx, 3, controlfile);
+            break;
+          case 'l': case 'L': /* define left half */
+            skipws(controlfile);
+            ctx->gl0 = Zgetc(controlfile) - '0';
+            figskiptoeol(controlfile);
+            break;
+          case 'r': case 'R': /* define right half */
+            skipws(controlfile);
+            ctx->gr0 = Zgetc(controlfile) - '0';
+            figskiptoeol(controlfile);
+            break;
+          default: /* meaningless "g" command */
+            figskiptoeol(controlfile);
+          }
+      case '\r': case '\n': /* blank line */
+        break;
+      default: /* Includes '#' */
+        figskiptoeol(controlfile);
+      }
+    }
+  Zclose(controlfile);
+  return ok ? FIGLET_OK : FIGLET_ENOMEM;
+}
+
+
+/****************************************************************************
+
+  clearline
+
+  Clears both the input (inchrline) and output (outputline) storage.
+
+****************************************************************************/
+
+static void clearline(figlet_context *ctx)
+{
+  int i;
+
+  for (i=0;i<ctx->outlinerows;i++) {
+    ctx->outputline[i] = ctx->outlinebuf[i];
+    if (ctx->right2left) {
+      ctx->outputline[i] += ctx->outlinelenlimit;
+      }
+    ctx->outputline[i][0] = '\0';
+    ctx->outlineedge[i].len = 0;
+    ctx->outlineedge[i].left = 0;
+    ctx->outlineedge[i].right = -1;
+    }
+  ctx->outlinelen = 0;
+  ctx->inchrlinelen = 0;
+  ctx->ckinchrlinelen = 0;
+}
+
+
+/****************************************************************************
+
+  linefree
+
+  Releases the line buffers, if any.
+
+****************************************************************************/
+
+static void linefree(figlet_context *ctx)
+{
+  int row;
+
+  if (ctx->outlinebuf != NULL) {
+    for (row=0;row<ctx->outlinerows;row++) {
+      free(ctx->outlinebuf[row]);
+      }
+    free(ctx->outlinebuf);
+    ctx->outlinebuf = NULL;
+    free(ctx->outputline);
+    ctx->outputline = NULL;
+    free(ctx->outlineedge);
+    ctx->outlineedge = NULL;
+    free(ctx->outlinescratch);
+    ctx->outlinescratch = NULL;
+    free(ctx->ckedge);
+    ctx->ckedge = NULL;
+    free(ctx->ckedgech);
+    ctx->ckedgech = NULL;
+    }
+  ctx->outlinerows = 0;
+  free(ctx->inchrline);
+  ctx->inchrline = NULL;
+}
+
+
+/****************************************************************************
+
+  linealloc
+
+  Allocates & clears outputline, inchrline. Sets inchrlinelenlimit.
+  Keeps the current buffers if they already fit the font and width.
+  Returns false, with none allocated, if there is no memory.
+
+****************************************************************************/
+
+static int linealloc(figlet_context *ctx)
+{
+  int row,ok;
+
+  if (ctx->outlinebuf!=NULL && ctx->outlinerows==ctx->font->charheight &&
+      ctx->outlinelenlimit==ctx->outputwidth-1) {
+    clearline(ctx);
+    return 1;
+    }
+  linefree(ctx);
+  ctx->outlinelenlimit = ctx->outputwidth-1;
+  ctx->outlinebuf =
+    (outchr**)figalloc(sizeof(outchr*)*ctx->font->charheight);
+  if (ctx->outlinebuf==NULL) {
+    return 0;
+    }
+  ctx->outlinerows = ctx->font->charheight;
+  ok = 1;
+  for (row=0;row<ctx->outlinerows;row++) {
+    ctx->outlinebuf[row] =
+      (outchr*)figalloc(sizeof(outchr)*(ctx->outlinelenlimit+1));
+    ok = ok && ctx->outlinebuf[row]!=NULL;
+    }
+  ctx->outputline = (outchr**)figalloc(sizeof(outchr*)*ctx->outlinerows);
+  ctx->outlineedge =
+    (lineedge*)figalloc(sizeof(lineedge)*ctx->outlinerows);
+  ctx->outlinescratch =
+    (outchr*)figalloc(sizeof(outchr)*(ctx->outlinelenlimit+1));
+  ctx->ckedge = (lineedge*)figalloc(sizeof(lineedge)*ctx->outlinerows);
+  ctx->ckedgech = (outchr*)figalloc(sizeof(outchr)*ctx->outlinerows);
+  ctx->inchrlinelenlimit = ctx->outputwidth*4+100;
+  ctx->inchrline = (inchr*)figalloc(sizeof(inchr)*(ctx->inchrlinelenlimit+1));
+  if (!ok || ctx->outputline==NULL || ctx->outlineedge==NULL ||
+      ctx->outlinescratch==NULL || ctx->ckedge==NULL ||
+      ctx->ckedgech==NULL || ctx->inchrline==NULL) {
+    linefree(ctx);
+    return 0;
+    }
+  clearline(ctx);
+  return 1;
+}
+
+
+/****************************************************************************
+
+  resolveoptions
+
+  Works out the effective smushmode, direction and justification from
+  the caller's options and the font's own settings.
+
+****************************************************************************/
+
+static void resolveoptions(figlet_context *ctx)
+{
+  figlet_font *font = ctx->font;
+
+  ctx->smushmode = ctx->opts.smushmode;
+  if (ctx->opts.smushoverride == SMO_NO)
+     ctx->smushmode = font->smushmode;
+  else if (ctx->opts.smushoverride == SMO_FORCE)
+     ctx->smushmode |= font->smushmode;
+
+  ctx->right2left = ctx->opts.right2left;
+  if (ctx->right2left<0) {
+    ctx->right2left = font->right2left;
+    }
+
+  ctx->justification = ctx->opts.justification;
+  if (ctx->justification<0) {
+    ctx->justification = 2*ctx->right2left;
+    }
+
+  ctx->outputwidth = ctx->opts.outputwidth;
+}
+
+
+/****************************************************************************
+
+  getletter
+
+  Sets currchar to point to the rows of the given character.
+  Sets currcharwidth to the width of this character.  A character of
+  a lazily loaded font is read here the first time it is used; if
+  there is no memory to read it, the render is ended, and the
+  "missing" character, which the font has read already, stands in.
+
+****************************************************************************/
+
+static void getletter(figlet_context *ctx, inchr c)
+{
+  const fcharinfo *fc;
+  const figglyph *g;
+
+  ctx->previouscharwidth = ctx->currcharwidth;
+  if (ctx->font->glyphs!=NULL) {
+    if ((g = figlazyglyph(ctx->font,c))==NULL) {
+      ctx->nomem = 1;
+      g = figlazyglyph(ctx->font,0);
+      }
+    ctx->currchar = g->rowoff;
+    ctx->curredge = g->edges;
+    ctx->currcells = g->cells;
+    ctx->currnarrow = g->narrow;
+    ctx->currcharwidth = g->width;
+    return;
+    }
+  fc = FIGFINDCHAR(ctx->font,c);
+  if (fc==NULL) {
+    fc = ctx->font->directchar[0];
+    }
+  ctx->currchar = ctx->font->rowoff+fc->row;
+  ctx->curredge = ctx->font->edges+fc->row;
+  ctx->currcells = ctx->font->cells;
+  ctx->currnarrow = ctx->font->narrow;
+  ctx->currcharwidth = fc->width;
+}
+
+
+/****************************************************************************
+
+  smushrule
+
+  Given 2 characters, neither of them a blank, attempts to smush them
+  into 1, according to smushmode.  Returns smushed character or '\0'
+  if no smushing can be done.
+
+  smushmode values are sum of following (all values smush blanks):
+    1: Smush equal chars (not hardblanks)
+    2: Smush '_' with any char in hierarchy below
+    4: hierarchy: "|", "/\\", "[]", "{}", "()", "<>"
+       Each class in hier. can be replaced by later class.
+    8: [ + ] -> |, { + } -> |, ( + ) -> |
+   16: / + \\ -> X, > + < -> X (only in that order)
+   32: hardblank + hardblank -> hardblank
+
+  The result depends only on the two characters, smushmode, hardblank
+  and right2left, which is what lets smushem() keep it in a table.
+
+****************************************************************************/
+
+static outchr smushrule(figlet_context *ctx, outchr lch, outchr rch)
+{
+  int smushmode = ctx->smushmode;
+  char hardblank = ctx->font->hardblank;
+
+  if ((smushmode & SM_SMUSH) == 0) return '\0';  /* kerning */
+
+  if ((smushmode & 63) == 0) {
+    /* This is smushing by universal overlapping. */
+    if (lch==' ') return rch;
+    if (rch==' ') return lch;
+    if (lch==hardblank) return rch;
+    if (rch==hardblank) return lch;
+      /* Above four lines ensure overlapping preference to */
+      /* visible characters. */
+    if (ctx->right2left==1) return lch;
+      /* Above line ensures that the dominant (foreground) */
+      /* fig-character for overlapping is the latter in the */
+      /* user's text, not necessarily the rightmost character. */
+    return rch;
+      /* Occurs in the absence of above exceptions. */
+    }
+
+  if (smushmode & SM_HARDBLANK) {
+    if (lch==hardblank && rch==hardblank) return lch;
+    }
+
+  if (lch==hardblank || rch==hardblank) return '\0';
+
+  if (smushmode & SM_EQUAL) {
+    if (lch==rch) return lch;
+    }
+
+  if (smushmode & SM_LOWLINE) {
+    if (lch=='_' && strchr("|/\\[]{}()<>",rch)) return rch;
+    if (rch=='_' && strchr("|/\\[]{}()<>",lch)) return lch;
+    }
+
+  if (smushmode & SM_HIERARCHY) {
+    if (lch=='|' && strchr("/\\[]{}()<>",rch)) return rch;
+    if (rch=='|' && strchr("/\\[]{}()<>",lch)) return lch;
+    if (strchr("/\\",lch) && strchr("[]{}()<>",rch)) return rch;
+    if (strchr("/\\",rch) && strchr("[]{}()<>",lch)) return lch;
+    if (strchr("[]",lch) && strchr("{}()<>",rch)) return rch;
+    if (strchr("[]",rch) && strchr("{}()<>",lch)) return lch;
+    if (strchr("{}",lch) && strchr("()<>",rch)) return rch;
+    if (strchr("{}",rch) && strchr("()<>",lch)) return lch;
+    if (strchr("()",lch) && strchr("<>",rch)) return rch;
+    if (strchr("()",rch) && strchr("<>",lch)) return lch;
+    }
+
+  if (smushmode & SM_PAIR) {
+    if (lch=='[' && rch==']') return '|';
+    if (rch=='[' && lch==']') return '|';
+    if (lch=='{' && rch=='}') return '|';
+    if (rch=='{' && lch=='}') return '|';
+    if (lch=='(' && rch==')') return '|';
+    if (rch=='(' && lch==')') return '|';
+    }
+
+  if (smushmode & SM_BIGX) {
+    if (lch=='/' && rch=='\\') return '|';
+    if (rch=='/' && lch=='\\') return 'Y';
+    if (lch=='>' && rch=='<') return 'X';
+      /* Don't want the reverse of above to give 'X'. */
+    }
+
+  return '\0';
+}
+
+
+/****************************************************************************
+
+  smushem
+
+  Given 2 characters, attempts to smush them into 1, according to
+  smushmode.  Returns smushed character or '\0' if no smushing can be
+  done.  See smushrule for the rules; pairs of chars below SMUSHCHARS
+  are looked up in the context's smush table, which is filled in as
+  pairs are met.
+
+****************************************************************************/
+
+static outchr smushem(figlet_context *ctx, outchr lch, outchr rch)
+{
+  unsigned short *entry;
+
+  if (lch==' ') return rch;
+  if (rch==' ') return lch;
+
+  if (ctx->previouscharwidth<2 || ctx->currcharwidth<2) return '\0';
+    /* Disallows overlapping if the previous character */
+    /* or the current character has a width of 1 or zero. */
+
+  if (CHARCODE(lch)<SMUSHCHARS && CHARCODE(rch)<SMUSHCHARS) {
+    entry = &ctx->smushtab[CHARCODE(lch)*SMUSHCHARS+CHARCODE(rch)];
+    if (*entry==0) {
+      *entry = (unsigned short)(CHARCODE(smushrule(ctx,lch,rch))+1);
+      }
+    return (outchr)(*entry-1);
+    }
+  return smushrule(ctx,lch,rch);
+}
+
+
+/****************************************************************************
+
+  smushtabinit
+
+  Makes sure the smush table is there and belongs to the current
+  smushmode, hardblank and direction, clearing it if not.  Returns
+  false if there is no memory.
+
+****************************************************************************/
+
+static int smushtabinit(figlet_context *ctx)
+{
+  if (ctx->smushtab==NULL) {
+    ctx->smushtab = (unsigned short*)figalloc(
+      sizeof(unsigned short)*SMUSHCHARS*SMUSHCHARS);
+    if (ctx->smushtab==NULL) {
+      return 0;
+      }
+    }
+  else if (ctx->smushtabmode==ctx->smushmode &&
+      ctx->smushtabhardblank==ctx->font->hardblank &&
+      ctx->smushtabr2l==ctx->right2left) {
+    return 1;
+    }
+  memset(ctx->smushtab,0,sizeof(unsigned short)*SMUSHCHARS*SMUSHCHARS);
+  ctx->smushtabmode = ctx->smushmode;
+  ctx->smushtabhardblank = ctx->font->hardblank;
+  ctx->smushtabr2l = ctx->right2left;
+  return 1;
+}
+
+
+/****************************************************************************
+
+  smushamt
+
+  Returns the maximum amount that the current character can be smushed
+  into the current line.  Works from the edge profiles of the line and
+  of the character, so no row is scanned.  The font pads every row of
+  a character to the character's width, so the profiles line up; the
+  result is still kept from going negative, which would have addchar
+  copy from before the character's cells.
+
+****************************************************************************/
+
+static int smushamt(figlet_context *ctx)
+{
+  int maxsmush,amt;
+  int row,linebd,charbd;
+  outchr ch1,ch2;
+  const fcedge *ce;
+  lineedge *le;
+
+  if ((ctx->smushmode & (SM_SMUSH | SM_KERN)) == 0) {
+    return 0;
+    }
+  maxsmush = ctx->currcharwidth;
+  for (row=0;row<ctx->font->charheight;row++) {
+    ce = &ctx->curredge[row];
+    le = &ctx->outlineedge[row];
+    if (ctx->right2left) {
+      if (maxsmush>le->len) {
+        maxsmush = le->len;
+        }
+      charbd = ce->right>0 ? ce->right : 0;
+      ch1 = ce->rightch;
+      linebd = le->left<le->len ? le->left : le->len;
+      ch2 = ctx->outputline[row][linebd];
+      amt = linebd+ctx->currcharwidth-1-charbd;
+      }
+    else {
+      linebd = le->right<le->len ? le->right : le->len-1;
+      if (linebd<0) {
+        linebd = 0;
+        }
+      ch1 = ctx->outputline[row][linebd];
+      charbd = ce->left;
+      ch2 = ce->leftch;
+      amt = charbd+ctx->outlinelen-1-linebd;
+      }
+    if (!ch1||ch1==' ') {
+      amt++;
+      }
+    else if (ch2) {
+      if (smushem(ctx,ch1,ch2)!='\0') {
+        amt++;
+        }
+      }
+    if (amt<maxsmush) {
+      maxsmush = amt;
+      }
+    }
+  return maxsmush>0 ? maxsmush : 0;
+}
+
+
+/****************************************************************************
+
+  lineedges
+
+  Brings the edge profile of one row of the output line up to date
+  after addchar has put the current character into it, given the
+  row's length before that.  The caller sets the new length.  A smushed
+  column is visible if it was visible in the line or in the character,
+  so the new edge follows from the two old ones.
+
+****************************************************************************/
+
+static void lineedges(figlet_context *ctx, int row, int smushamount,
+  int oldlen)
+{
+  const fcedge *ce = &ctx->curredge[row];
+  lineedge *le = &ctx->outlineedge[row];
+  int bd;
+
+  if (ctx->right2left) {
+    /* The character is now at the start of the line */
+    if (le->left<smushamount) {
+      bd = ctx->currcharwidth-smushamount+le->left;
+      }
+    else {
+      bd = ce->len+le->left-smushamount;
+      }
+    if (ce->left<ce->len && ce->left<bd) {
+      bd = ce->left;
+      }
+    le->left = bd;
+    }
+  else {
+    /* The character is now at the end of the line */
+    if (ce->right>=smushamount) {
+      le->right = oldlen+ce->right-smushamount;
+      }
+    else if (ce->right>=0) {
+      bd = ctx->outlinelen-smushamount+ce->right;
+      if (bd<0) {
+        bd = 0;
+        }
+      if (bd>le->right) {
+        le->right = bd;
+        }
+      }
+    }
+}
+
+
+/****************************************************************************
+
+  linecheckpoint
+
+  Records the output line so that linerestore can go back to it.
+  Characters added later only change a row from its visible edge on
+  (its last visible char left-to-right, its first right-to-left), and
+  everything past the edge is blank, so the lengths, the edges and the
+  chars at the edges are all that has to be kept.
+
+****************************************************************************/
+
+static void linecheckpoint(figlet_context *ctx)
+{
+  int row;
+  lineedge *le;
+
+  for (row=0;row<ctx->font->charheight;row++) {
+    le = &ctx->outlineedge[row];
+    ctx->ckedge[row] = *le;
+    if (ctx->right2left) {
+      ctx->ckedgech[row] = ctx->outputline[row][le->left];
+      }
+    else {
+      ctx->ckedgech[row] = ctx->outputline[row][le->right>0?le->right:0];
+      }
+    }
+  ctx->ckinchrlinelen = ctx->inchrlinelen;
+  ctx->ckcurrcharwidth = ctx->currcharwidth;
+}
+
+
+/****************************************************************************
+
+  linerestore
+
+  Puts the output line back the way it was at the last checkpoint.
+
+****************************************************************************/
+
+static void linerestore(figlet_context *ctx)
+{
+  int row,k;
+  outchr *line;
+  lineedge *le;
+
+  for (row=0;row<ctx->font->charheight;row++) {
+    le = &ctx->ckedge[row];
+    if (ctx->right2left) {
+      line = ctx->outlinebuf[row]+ctx->outlinelenlimit-le->len;
+      for (k=0;k<le->left;k++) {
+        line[k] = ' ';
+        }
+      if (le->left<le->len) {
+        line[le->left] = ctx->ckedgech[row];
+        }
+      ctx->outputline[row] = line;
+      }
+    else {
+      line = ctx->outputline[row];
+      k = le->right;
+      if (k>=0) {
+        line[k] = ctx->ckedgech[row];
+        }
+      for (k++;k<le->len;k++) {
+        line[k] = ' ';
+        }
+      line[le->len] = '\0';
+      }
+    ctx->outlineedge[row] = *le;
+    }
+  ctx->outlinelen = ctx->outlineedge[0].len;
+  ctx->inchrlinelen = ctx->ckinchrlinelen;
+  ctx->currcharwidth = ctx->ckcurrcharwidth;
+}
+
+
+/****************************************************************************
+
+  cellcopy
+
+  Copies n cells of the current character, starting at offset off in
+  its cells, into an output line.
+
+****************************************************************************/
+
+static void cellcopy(outchr *line, const figlet_context *ctx, int off, int n)
+{
+  const narrowchr *cell;
+  int k;
+
+  if (!ctx->currnarrow) {
+    memcpy(line,(const outchr*)ctx->currcells+off,sizeof(outchr)*n);
+    return;
+    }
+  cell = (const narrowchr*)ctx->currcells+off;
+  for (k=0;k<n;k++) {
+    line[k] = cell[k];
+    }
+}
+
+
+/****************************************************************************
+
+  addchar
+
+  Attempts to add the given character onto the end of the current line.
+  Returns 1 if this can be done, 0 otherwise.
+
+****************************************************************************/
+
+static int addchar(figlet_context *ctx, inchr c)
+{
+  int smushamount,row,k,column,len,m,n,off,charend;
+  outchr *line,*templine;
+  const figlet_font *font;
+  int currcharwidth;
+  const fcedge *ce;
+  const void *cells;
+  int narrow;
+
+  getletter(ctx,c);
+  font = ctx->font;
+  cells = ctx->currcells;
+  narrow = ctx->currnarrow;
+  currcharwidth = ctx->currcharwidth;
+  smushamount = smushamt(ctx);
+  if (ctx->outlinelen+currcharwidth-smushamount>ctx->outlinelenlimit
+      ||ctx->inchrlinelen+1>ctx->inchrlinelenlimit) {
+    return 0;
+    }
+  if (c==' ' && ctx->inchrlinelen>0 &&
+      ctx->inchrline[ctx->inchrlinelen-1]!=' ') {
+    linecheckpoint(ctx);
+    }
+
+  for (row=0;row<font->charheight;row++) {
+    line = ctx->outputline[row];
+    len = ctx->outlineedge[row].len;
+    off = ctx->currchar[row];
+    ce = &ctx->curredge[row];
+    n = ce->len-smushamount;  /* chars of the character not smushed */
+    if (n<0) {
+      n = 0;
+      }
+    if (len+n>ctx->outlinelenlimit) {  /* only if rows differ in width */
+      n = ctx->outlinelenlimit-len;
+      }
+    if (ctx->right2left && ce->len==currcharwidth && n==ce->len-smushamount) {
+      /* Smush the end of the character into the start of the row, */
+      /* then put the rest of the character in front of it */
+      charend = off+currcharwidth-smushamount;
+      for (k=0;k<smushamount;k++) {
+        line[k] = smushem(ctx,FIGCELL(cells,narrow,charend+k),line[k]);
+        }
+      line -= n;
+      cellcopy(line,ctx,off,n);
+      ctx->outputline[row] = line;
+      }
+    else if (ctx->right2left) {
+      /* Rows of the character differ in width: build the new row */
+      /* in the scratch buffer and copy it into place */
+      templine = ctx->outlinescratch;
+      m = ce->len<len+n ? ce->len : len+n;
+      cellcopy(templine,ctx,off,m);
+      for (k=0;k<smushamount;k++) {
+        column = currcharwidth-smushamount+k;
+        if (column < m) {
+          templine[column] = smushem(ctx,templine[column],line[k]);
+          }
+        }
+      memcpy(templine+m,line+smushamount,sizeof(outchr)*(len+n-m));
+      line -= n;
+      memcpy(line,templine,sizeof(outchr)*(len+n));
+      ctx->outputline[row] = line;
+      }
+    else {
+      for (k=0;k<smushamount;k++) {
+        column = ctx->outlinelen-smushamount+k;
+        if (column < 0) {
+          column = 0;
+          }
+        line[column] = smushem(ctx,line[column],
+          k<ce->len ? FIGCELL(cells,narrow,off+k) : ' ');
+        }
+      cellcopy(line+len,ctx,off+smushamount,n);
+      line[len+n] = '\0';
+      }
+    lineedges(ctx,row,smushamount,len);
+    ctx->outlineedge[row].len = len+n;
+    }
+  ctx->outlinelen = ctx->outlineedge[0].len;
+  ctx->inchrline[ctx->inchrlinelen++] = c;
+  return 1;
+}
+
+
+/****************************************************************************
+
+  emit
+
+  Hands a chunk of output to the output callback.  After the first
+  failure, output is dropped and rendering stops at the next character.
+
+****************************************************************************/
+
+static void emit(figlet_context *ctx, const char *buf, size_t len)
+{
+  if (ctx->outerror) return;
+  if ((*ctx->out)(ctx->userdata,buf,len)) {
+    ctx->outerror = 1;
+    }
+}
+
+
+/****************************************************************************
+
+  outreserve
+
+  Makes room for at least need more bytes of output in outbuf and
+  returns where they go, or sets nomem and returns NULL if there is
+  no memory.
+
+****************************************************************************/
+
+static char *outreserve(figlet_context *ctx, size_t need)
+{
+  char *buf;
+  size_t size;
+
+  if (ctx->outbuflen+need>ctx->outbufsize) {
+    size = ctx->outbufsize*2;
+    if (size<ctx->outbuflen+need) {
+      size = ctx->outbuflen+need;
+      }
+    if ((buf = figalloc(size))==NULL) {
+      ctx->nomem = 1;
+      return NULL;
+      }
+    if (ctx->outbuflen>0) {
+      memcpy(buf,ctx->outbuf,ctx->outbuflen);
+      }
+    free(ctx->outbuf);
+    ctx->outbuf = buf;
+    ctx->outbufsize = size;
+    }
+  return ctx->outbuf+ctx->outbuflen;
+}
+
+
+/****************************************************************************
+
+  outflush
+
+  Hands everything in outbuf to the output callback.
+
+****************************************************************************/
+
+static void outflush(figlet_context *ctx)
+{
+  if (ctx->outbuflen>0) {
+    emit(ctx,ctx->outbuf,ctx->outbuflen);
+    ctx->outbuflen = 0;
+    }
+}
+
+
+/****************************************************************************
+
+  putstring
+
+  Encodes the given string of len chars into outbuf, substituting
+  blanks for hardblanks.  If outputwidth is 1, encodes the entire
+  string; otherwise encodes at most outputwidth-1 characters.  Adds a
+  newline at the end of the string.  The string is left-justified,
+  centered or right-justified (taking outputwidth as the screen width)
+  if justification is 0, 1 or 2, respectively.  The caller flushes
+  outbuf with outflush.
+
+****************************************************************************/
+
+static void putstring(figlet_context *ctx, const outchr *string, int len)
+{
+  int i,pad;
+  char *p;
+  outchr c;
+  int outputwidth = ctx->outputwidth;
+  int justification = ctx->justification;
+  char hardblank = ctx->font->hardblank;
+
+  pad = 0;
+  if (outputwidth>1) {
+    if (len>outputwidth-1) {
+      len = outputwidth-1;
+      }
+    if (justification>0) {
+      /* the number of i>=1 with (3-j)*i+len+j-2 < outputwidth */
+      pad = outputwidth-len-justification+2;
+      pad = pad>0 ? (pad-1)/(3-justification) : 0;
+      }
+    }
+#ifdef TLF_FONTS
+  p = outreserve(ctx,(size_t)pad+(size_t)len*6+1);
+#else
+  p = outreserve(ctx,(size_t)pad+(size_t)len+1);
+#endif
+  if (p==NULL) {
+    return;
+    }
+  memset(p,' ',pad);
+  p += pad;
+  for (i=0;i<len;i++) {
+    c = string[i];
+#ifdef TLF_FONTS
+    /* UTF-8, as wchar_to_utf8() encodes a single char */
+    if (c<0x80) {
+      if (c<0) continue;
+      *p++ = c==hardblank ? ' ' : (char)c;
+      }
+    else if (c<0x800) {
+      *p++ = (char)(0xc0|(c>>6));
+      *p++ = (char)(0x80|(c&0x3f));
+      }
+    else if (c<0x10000) {
+      if (c>=0xd800 && c<=0xdfff) continue;  /* surrogates */
+      *p++ = (char)(0xe0|(c>>12));
+      *p++ = (char)(0x80|((c>>6)&0x3f));
+      *p++ = (char)(0x80|(c&0x3f));
+      }
+    else if (c<0x200000) {
+      *p++ = (char)(0xf0|(c>>18));
+      *p++ = (char)(0x80|((c>>12)&0x3f));
+      *p++ = (char)(0x80|((c>>6)&0x3f));
+      *p++ = (char)(0x80|(c&0x3f));
+      }
+    else if (c<0x4000000) {
+      *p++ = (char)(0xf8|(c>>24));
+      *p++ = (char)(0x80|((c>>18)&0x3f));
+      *p++ = (char)(0x80|((c>>12)&0x3f));
+      *p++ = (char)(0x80|((c>>6)&0x3f));
+      *p++ = (char)(0x80|(c&0x3f));
+      }
+    else {
+      *p++ = (char)(0xfc|((c>>30)&0x01));
+      *p++ = (char)(0x80|((c>>24)&0x3f));
+      *p++ = (char)(0x80|((c>>18)&0x3f));
+      *p++ = (char)(0x80|((c>>12)&0x3f));
+      *p++ = (char)(0x80|((c>>6)&0x3f));
+      *p++ = (char)(0x80|(c&0x3f));
+      }
+#else
+    *p++ = c==hardblank ? ' ' : c;
+#endif
+    }
+  *p++ = '\n';
+  ctx->outbuflen = p-ctx->outbuf;
+}
+
+
+/****************************************************************************
+
+  printline
+
+  Prints outputline using putstring, then clears the current line.
+
+****************************************************************************/
+
+static void printline(figlet_context *ctx)
+{
+  int i;
+
+  for (i=0;i<ctx->font->charheight;i++) {
+    putstring(ctx,ctx->outputline[i],ctx->outlineedge[i].len);
+    }
+  outflush(ctx);
+  clearline(ctx);
+}
+
+
+/****************************************************************************
+
+  splitline
+
+  Splits inchrline at the last word break (bunch of consecutive blanks).
+  Makes a new line out of the first part and prints it using
+  printline.  Makes a new line out of the second part and returns.
+  The first part is normally the line as it was at the last checkpoint,
+  so only the second part has to be added again.
+
+****************************************************************************/
+
+static void splitline(figlet_context *ctx)
+{
+  int i,gotspace,lastspace,len1,len2;
+  inchr *inchrline = ctx->inchrline;
+  int inchrlinelen = ctx->inchrlinelen;
+
+  gotspace = 0;
+  lastspace = inchrlinelen-1;
+  for (i=inchrlinelen-1;i>=0;i--) {
+    if (!gotspace && inchrline[i]==' ') {
+      gotspace = 1;
+      lastspace = i;
+      }
+    if (gotspace && inchrline[i]!=' ') {
+      break;
+      }
+    }
+  len1 = i+1;
+  len2 = inchrlinelen-lastspace-1;
+  if (len1>0 && len1==ctx->ckinchrlinelen) {
+    linerestore(ctx);
+    }
+  else {
+    clearline(ctx);
+    for (i=0;i<len1;i++) {
+      addchar(ctx,inchrline[i]);
+      }
+    }
+  printline(ctx);
+  /* inchrline is refilled from the front, behind where it is read */
+  for (i=0;i<len2;i++) {
+    addchar(ctx,inchrline[lastspace+1+i]);
+    }
+}
+
+
+/****************************************************************************
+
+  groupsegs
+
+  Works out what one group of translate commands (the ones between two
+  freezes, starting at group) does, as segments covering the whole
+  inchr range: each gets the offset of the first command whose range
+  has it, or 0.  Returns the number of segments, which are Alloc'd in
+  *segsp, or -1 if there is no memory.  Sets *nextp to the freeze that
+  ends the group, or NULL.
+
+****************************************************************************/
+
+static int inchrcmp(const void *a, const void *b)
+{
+  inchr x = *(const inchr*)a;
+  inchr y = *(const inchr*)b;
+
+  return x<y ? -1 : x>y;
+}
+
+static int groupsegs(comnode *group, mapseg **segsp, comnode **nextp)
+{
+  comnode *cmptr;
+  inchr *starts;
+  mapseg *segs;
+  int i,n,nstarts;
+
+  n = 0;
+  for (cmptr=group;cmptr!=NULL && cmptr->thecommand;cmptr=cmptr->next) {
+    n++;
+    }
+  *nextp = cmptr;
+
+  /* A segment starts at the start and just after the end of each range */
+  if ((starts = (inchr*)figalloc(sizeof(inchr)*(2*n+1)))==NULL) {
+    return -1;
+    }
+  nstarts = 0;
+  starts[nstarts++] = LONG_MIN;
+  for (cmptr=group;cmptr!=*nextp;cmptr=cmptr->next) {
+    if (cmptr->rangelo>cmptr->rangehi) continue;
+    starts[nstarts++] = cmptr->rangelo;
+    if (cmptr->rangehi<LONG_MAX) {
+      starts[nstarts++] = cmptr->rangehi+1;
+      }
+    }
+  qsort(starts,nstarts,sizeof(inchr),inchrcmp);
+
+  if ((segs = (mapseg*)figalloc(sizeof(mapseg)*nstarts))==NULL) {
+    free(starts);
+    return -1;
+    }
+  n = 0;
+  for (i=0;i<nstarts;i++) {
+    if (i>0 && starts[i]==starts[i-1]) continue;
+    segs[n].lo = starts[i];
+    segs[n].offset = 0;
+    for (cmptr=group;cmptr!=*nextp;cmptr=cmptr->next) {
+      if (starts[i]>=cmptr->rangelo && starts[i]<=cmptr->rangehi) {
+        segs[n].offset = cmptr->offset;
+        break;
+        }
+      }
+    if (n>0) {
+      segs[n-1].hi = starts[i]-1;
+      }
+    n++;
+    }
+  segs[n-1].hi = LONG_MAX;
+  free(starts);
+  *segsp = segs;
+  return n;
+}
+
+
+/****************************************************************************
+
+  findseg
+
+  Returns the index of the segment that has c in it, in segments that
+  cover the whole inchr range.
+
+****************************************************************************/
+
+static int findseg(const mapseg *segs, int nsegs, inchr c)
+{
+  int lo,hi,mid;
+
+  lo = 0;
+  hi = nsegs-1;
+  for (;;) {
+    mid = (lo+hi)/2;
+    if (c<segs[mid].lo) {
+      hi = mid-1;
+      }
+    else if (c>segs[mid].hi) {
+      lo = mid+1;
+      }
+    else {
+      return mid;
+      }
+    }
+}
+
+
+/****************************************************************************
+
+  addseg
+
+  Appends a segment to an Alloc'd array of segments, joining it to the
+  last one if they have the same offset.  Returns false if there is no
+  memory, leaving the array as it was.
+
+****************************************************************************/
+
+static int addseg(mapseg **segsp, int *np, int *maxp, inchr lo, inchr hi,
+  inchr offset)
+{
+  mapseg *seg;
+  int max;
+
+  if (*np>0 && (*segsp)[*np-1].offset==offset) {
+    (*segsp)[*np-1].hi = hi;
+    return 1;
+    }
+  if (*np>=*maxp) {
+    max = *maxp>0 ? *maxp*2 : 64;
+    if ((seg = (mapseg*)realloc(*segsp,sizeof(mapseg)*max))==NULL) {
+      return 0;
+      }
+    *segsp = seg;
+    *maxp = max;
+    }
+  seg = &(*segsp)[(*np)++];
+  seg->lo = lo;
+  seg->hi = hi;
+  seg->offset = offset;
+  return 1;
+}
+
+
+/****************************************************************************
+
+  buildmapping
+
+  Builds the mapping the control file commands add up to, one group
+  of translates at a time: each segment of the mapping so far is split
+  where what it maps to crosses into another segment of the group.
+  Returns false if there is no memory, leaving the mapping stale, so
+  that it is built again next time.
+
+****************************************************************************/
+
+static int buildmapping(figlet_context *ctx)
+{
+  mapseg *segs,*next,*grp;
+  int nsegs,nnext,maxnext,ngrp,i,j,ok;
+  inchr lo,hi,c;
+  comnode *group;
+
+  ctx->mapstale = 0;
+  free(ctx->mapsegs);
+  free(ctx->mapdirect);
+  ctx->mapsegs = NULL;
+  ctx->mapdirect = NULL;
+  ctx->nmapsegs = 0;
+
+  segs = NULL;
+  nsegs = maxnext = 0;
+  ok = addseg(&segs,&nsegs,&maxnext,LONG_MIN,LONG_MAX,0);
+  for (group=ctx->commandlist;ok && group!=NULL;) {
+    if (!group->thecommand) {
+      group = group->next;
+      continue;
+      }
+    if ((ngrp = groupsegs(group,&grp,&group))<0) {
+      ok = 0;
+      break;
+      }
+    next = NULL;
+    nnext = maxnext = 0;
+    for (i=0;ok && i<nsegs;i++) {
+      /* What segs[i] maps to, split by the group's segments */
+      lo = segs[i].lo+segs[i].offset;
+      hi = segs[i].hi+segs[i].offset;
+      j = findseg(grp,ngrp,lo);
+      for (;;) {
+        if (!(ok = addseg(&next,&nnext,&maxnext,lo-segs[i].offset,
+            (grp[j].hi<hi ? grp[j].hi : hi)-segs[i].offset,
+            segs[i].offset+grp[j].offset))) {
+          break;
+          }
+        if (grp[j].hi>=hi) break;
+        lo = grp[++j].lo;
+        }
+      }
+    free(grp);
+    free(segs);
+    segs = next;
+    nsegs = nnext;
+    }
+
+  if (!ok) {
+    free(segs);
+    ctx->mapstale = 1;
+    return 0;
+    }
+  if (nsegs==1 && segs[0].offset==0) {  /* maps nothing */
+    free(segs);
+    return 1;
+    }
+  if ((ctx->mapdirect = (inchr*)figalloc(sizeof(inchr)*MAPDIRECT))==NULL) {
+    free(segs);
+    ctx->mapstale = 1;
+    return 0;
+    }
+  ctx->mapsegs = segs;
+  ctx->nmapsegs = nsegs;
+  for (i=0;segs[i].hi<0;i++) ;
+  for (c=0;c<MAPDIRECT;c++) {
+    if (c>segs[i].hi) i++;
+    ctx->mapdirect[c] = c+segs[i].offset;
+    }
+  return 1;
+}
+
+
+/****************************************************************************
+
+  handlemapping
+
+  Given an input character (type inchr), executes re-mapping commands
+  read from control files.  Returns re-mapped character (inchr).
+
+****************************************************************************/
+
+static inchr handlemapping(figlet_context *ctx, inchr c)
+{
+  if (ctx->nmapsegs==0) {
+    return c;
+    }
+  if (c>=0 && c<MAPDIRECT) {
+    return ctx->mapdirect[c];
+    }
+  return c+ctx->mapsegs[findseg(ctx->mapsegs,ctx->nmapsegs,c)].offset;
+}
+
+/****************************************************************************
+
+  inrefill
+
+  Called by Agetchar when the input buffer is empty.  Has the input
+  source refill it and returns its first byte, or EOF at the end of
+  input.  EOF is sticky.
+
+****************************************************************************/
+
+static int inrefill(figlet_context *ctx)
+{
+  while (ctx->inptr>=ctx->inend) {
+    if (ctx->refill==NULL || !(*ctx->refill)(ctx)) {
+      ctx->refill = NULL;
+      ctx->inptr = ctx->inend;
+      return EOF;
+      }
+    }
+  return *ctx->inptr++;
+}
+
+
+/****************************************************************************
+
+  Agetchar
+
+  Gets the next byte of input.  Only goes further than the input
+  buffer when it is empty.
+
+****************************************************************************/
+
+#define Agetchar(ctx) \
+  ((ctx)->inptr<(ctx)->inend ? (int)*(ctx)->inptr++ : inrefill(ctx))
+
+/* Puts back the byte Agetchar just returned, which is still there */
+#define Aungetchar(ctx) ((ctx)->inptr--)
+
+
+/****************************************************************************
+
+  Input decoder
+
+  getinchr reads the input through a state machine, one per multibyte
+  mode, that is fed a byte at a time and never calls itself, so no
+  run of escape sequences or shifts can make it go deeper.  The state
+  is kept in the context between bytes, so a sequence may be split
+  across input buffers, and the chars are decoded a buffer at a time
+  into decbuf.  Runs of bytes that are chars by themselves are
+  decoded by table lookup without going through the state machine.
+
+****************************************************************************/
+
+/* Decoder states */
+#define DS_GROUND 0    /* at the start of a char */
+#define DS_TRAIL 1     /* after the first byte of a double-byte char */
+#define DS_ESC 2       /* ISO 2022: after ESC */
+#define DS_ESCMB 3     /* ISO 2022: after ESC $ */
+#define DS_DESIG 4     /* ISO 2022: before the final byte of a */
+                       /* designation; declead is its EA_* action */
+#define DS_TILDE 5     /* HZ: after ~ */
+#define DS_HZ 6        /* HZ: at the start of a double-byte char */
+#define DS_HZTRAIL 7   /* HZ: after the first byte of a double-byte char */
+#define DS_EOF 8       /* at the end of input */
+
+/* ISO 2022 byte classes */
+enum {
+  IC_CT,  /* a char by itself */
+  IC_GL,  /* graphic char in the left half */
+  IC_GR,  /* graphic char in the right half */
+  IC_ES,  /* ESC */
+  IC_SO,  /* invoke G1 into GL */
+  IC_SI,  /* invoke G0 into GL */
+  IC_S2,  /* invoke G2 for the next char */
+  IC_S3   /* invoke G3 for the next char */
+  };
+
+/* Short names, to lay out the table */
+#define CT IC_CT
+#define GL IC_GL
+#define GR IC_GR
+#define ES IC_ES
+#define SO IC_SO
+#define SI IC_SI
+#define S2 IC_S2
+#define S3 IC_S3
+
+static const unsigned char isoclass[256] = {
+  CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,SO,SI,
+  CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,ES,CT,CT,CT,CT,
+  CT,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,
+  GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,
+  GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,
+  GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,
+  GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,
+  GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,GL,CT,
+  CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,S2,S3,
+  CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,CT,
+  GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,
+  GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,
+  GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,
+  GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,
+  GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,
+  GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,GR,
+  };
+
+#undef CT
+#undef GL
+#undef GR
+#undef ES
+#undef SO
+#undef SI
+#undef S2
+#undef S3
+
+/* DBCS and Shift-JIS: true for the first byte of a double-byte char */
+static const unsigned char dbcslead[256] = {
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  };
+
+/* What ISO 2022 escape sequences do: action<<2 | n, for Gn */
+#define EA_CHAR 0   /* nothing: ESC x is read as char 0x100+x */
+#define EA_SS 1     /* invoke Gn for the next char */
+#define EA_LSGL 2   /* invoke Gn into GL */
+#define EA_LSGR 3   /* invoke Gn into GR */
+#define EA_D94 4    /* set Gn to a 94-char set */
+#define EA_D96 5    /* set Gn to a 96-char set */
+#define EA_D9494 6  /* set Gn to a 94 x 94 char set */
+#define EA_MB 7     /* ESC $: a 94 x 94 char set follows */
+#define EA(action,n) ((action)<<2 | (n))
+
+
+/****************************************************************************
+
+  escaction
+
+  Returns the EA() action of the escape sequence ESC x.
+
+****************************************************************************/
+
+static int escaction(int x)
+{
+  switch (x) {
+    case 'N': return EA(EA_SS,2);
+    case 'O': return EA(EA_SS,3);
+    case 'n': return EA(EA_LSGL,2);
+    case 'o': return EA(EA_LSGL,3);
+    case '~': return EA(EA_LSGR,1);
+    case '}': return EA(EA_LSGR,2);
+    case '|': return EA(EA_LSGR,3);
+    case '(': return EA(EA_D94,0);
+    case ')': return EA(EA_D94,1);
+    case '*': return EA(EA_D94,2);
+    case '+': return EA(EA_D94,3);
+    case '-': return EA(EA_D96,1);
+    case '.': return EA(EA_D96,2);
+    case '/': return EA(EA_D96,3);
+    case '$': return EA(EA_MB,0);
+    default: return EA(EA_CHAR,0);
+    }
+}
+
+
+/****************************************************************************
+
+  singleshift
+
+  Invokes Gn into both GL and GR for the next char only.  A single
+  shift before that char is complete replaces this one; either way,
+  GL and GR go back to what they were before the first.
+
+****************************************************************************/
+
+static void singleshift(figlet_context *ctx, int n)
+{
+  if (!ctx->ss) {
+    ctx->ss = 1;
+    ctx->ssgl = ctx->gl;
+    ctx->ssgr = ctx->gr;
+    }
+  ctx->gl = ctx->gr = n;
+}
+
+
+/****************************************************************************
+
+  isochar
+
+  Called by decbyte.  Takes byte ch in ISO 2022 mode at the start of a
+  char.  Stores the char if ch completes it at out, and returns where
+  the next one goes.
+
+****************************************************************************/
+
+static inchr *isochar(figlet_context *ctx, int ch, inchr *out)
+{
+  switch (isoclass[ch]) {
+    case IC_GL:
+      if (ctx->gndbl[ctx->gl]) {
+        ctx->declead = ch;
+        ctx->decstate = DS_TRAIL;
+        }
+      else *out++ = ctx->gn[ctx->gl] | ch;
+      break;
+    case IC_GR:
+      if (ctx->gndbl[ctx->gr]) {
+        ctx->declead = ch;
+        ctx->decstate = DS_TRAIL;
+        }
+      else *out++ = ctx->gn[ctx->gr] | (ch & ~0x80);
+      break;
+    case IC_ES:
+      ctx->decstate = DS_ESC;
+      break;
+    case IC_SO:
+      ctx->gl = 1;
+      break;
+    case IC_SI:
+      ctx->gl = 0;
+      break;
+    case IC_S2:
+      singleshift(ctx,2);
+      break;
+    case IC_S3:
+      singleshift(ctx,3);
+      break;
+    default:
+      *out++ = ch;
+    }
+  return out;
+}
+
+
+/****************************************************************************
+
+  iso2022
+
+  Called by decbyte.  Interprets ISO 2022 sequences: takes the next
+  byte, or EOF, in ISO 2022 mode.
+
+****************************************************************************/
+
+static inchr *iso2022(figlet_context *ctx, int ch, inchr *out)
+{
+  inchr *start;
+  int action,n;
+
+  start = out;
+  switch (ctx->decstate) {
+    case DS_GROUND:
+      if (ch == EOF) {
+        ctx->decstate = DS_EOF;
+        return out;
+        }
+      out = isochar(ctx,ch,out);
+      break;
+    case DS_TRAIL:
+      n = (ctx->declead & 0x80) ? ctx->gr : ctx->gl;
+      *out++ = ctx->gn[n] | ((inchr)ctx->declead << 8) | ch;
+      ctx->decstate = DS_GROUND;
+      break;
+    case DS_ESC:
+      ctx->decstate = DS_GROUND;
+      if (ch == EOF) { /* ESC at the end is read as 0xFF */
+        out = isochar(ctx,0xFF,out);
+        break;
+        }
+      action = ch < 0x80 ? escaction(ch) : EA(EA_CHAR,0);
+      n = action & 3;
+      switch (action >> 2) {
+        case EA_SS:
+          singleshift(ctx,n);
+          break;
+        case EA_LSGL:
+          ctx->gl = n;
+          break;
+        case EA_LSGR:
+          ctx->gr = n;
+          break;
+        case EA_D94: case EA_D96:
+          ctx->declead = action;
+          ctx->decstate = DS_DESIG;
+          break;
+        case EA_MB:
+          ctx->decstate = DS_ESCMB;
+          break;
+        default:
+          *out++ = ch + 0x100;
+        }
+      break;
+    case DS_ESCMB:
+      ctx->decstate = DS_GROUND;
+      if (ch == EOF) {
+        *out++ = EOF + 0x200;
+        break;
+        }
+      action = ch < 0x80 ? escaction(ch) : EA(EA_CHAR,0);
+      if ((action >> 2) == EA_D94) {
+        ctx->declead = EA(EA_D9494,action & 3);
+        ctx->decstate = DS_DESIG;
+        }
+      else { /* set G0 to 94 x 94 char set (deprecated) */
+        ctx->gn[0] = 65536L * ch;
+        ctx->gndbl[0] = 1;
+        }
+      break;
+    case DS_DESIG:
+      ctx->decstate = DS_GROUND;
+      n = ctx->declead & 3;
+      switch (ctx->declead >> 2) {
+        case EA_D94:
+          if (ch == 'B') ch = 0; /* ASCII */
+          ctx->gn[n] = 65536L * ch;
+          ctx->gndbl[n] = 0;
+          break;
+        case EA_D96:
+          if (ch == 'A') ch = 0; /* Latin-1 top half */
+          ctx->gn[n] = (65536L * ch) | 0x80;
+          ctx->gndbl[n] = 0;
+          break;
+        default:
+          ctx->gn[n] = 65536L * ch;
+          ctx->gndbl[n] = 1;
+        }
+      break;
+    }
+  if (out>start && ctx->ss) {
+    ctx->ss = 0;
+    ctx->gl = ctx->ssgl;
+    ctx->gr = ctx->ssgr;
+    }
+  return out;
+}
+
+
+/****************************************************************************
+
+  decbyte
+
+  Called by decfill.  Feeds the next byte of input, or EOF, to the
+  decoder of the current multibyte mode.  Stores the char at out if
+  the byte completes one, and returns where the next one goes.  Once
+  EOF has been fed in enough times to finish off any sequence left
+  open, the decoder is in DS_EOF.
+
+****************************************************************************/
+
+static inchr *decbyte(figlet_context *ctx, int ch, inchr *out)
+{
+  switch (ctx->multibyte) {
+    case 1: /* DBCS */
+    case 4: /* Shift-JIS */
+      if (ctx->decstate == DS_TRAIL) {
+        *out++ = ((inchr)ctx->declead << 8) + ch;
+        ctx->decstate = DS_GROUND;
+        }
+      else if (ch == EOF) {
+        ctx->decstate = DS_EOF;
+        }
+      else if (dbcslead[ch]) {
+        ctx->declead = ch;
+        ctx->decstate = DS_TRAIL;
+        }
+      else *out++ = ch;
+      return out;
+    case 3: /* HZ */
+      switch (ctx->decstate) {
+        case DS_GROUND:
+          if (ch == EOF) ctx->decstate = DS_EOF;
+          else if (ch == '~') ctx->decstate = DS_TILDE;
+          else *out++ = ch;
+          break;
+        case DS_TILDE:
+          if (ch == '{') ctx->decstate = DS_HZ;
+          else {
+            if (ch == '~') *out++ = ch;
+            ctx->decstate = DS_GROUND;
+            }
+          break;
+        case DS_HZ:
+          if (ch == EOF) ctx->decstate = DS_EOF;
+          else {
+            ctx->declead = ch;
+            ctx->decstate = DS_HZTRAIL;
+            }
+          break;
+        case DS_HZTRAIL:
+          if (ctx->declead == '}' && ch == '~') ctx->decstate = DS_GROUND;
+          else {
+            *out++ = ((inchr)ctx->declead << 8) + ch;
+            ctx->decstate = DS_HZ;
+            }
+          break;
+        }
+      return out;
+    default: /* ISO 2022 */
+      return iso2022(ctx,ch,out);
+    }
+}
+
+
+/****************************************************************************
+
+  decrun
+
+  Called by decfill with the decoder at the start of a char.  Decodes
+  the run of input bytes that are chars by themselves (and in HZ
+  double-byte mode, the run of byte pairs), into out up to outend.
+  Returns where the next char goes.
+
+****************************************************************************/
+
+static inchr *decrun(figlet_context *ctx, inchr *out, inchr *outend)
+{
+  const unsigned char *p,*end;
+  int ch,cls;
+  inchr glset,grset;
+  int gldbl,grdbl;
+
+  p = ctx->inptr;
+  end = ctx->inend;
+  if (end-p > outend-out) end = p+(outend-out);
+  switch (ctx->multibyte) {
+    case 1: /* DBCS */
+    case 4: /* Shift-JIS */
+      while (p<end && !dbcslead[*p]) {
+        *out++ = *p++;
+        }
+      break;
+    case 3: /* HZ */
+      if (ctx->decstate == DS_HZ) {
+        while (p+1<end && !(p[0]=='}' && p[1]=='~')) {
+          *out++ = ((inchr)p[0] << 8) + p[1];
+          p += 2;
+          }
+        }
+      else {
+        while (p<end && *p!='~') {
+          *out++ = *p++;
+          }
+        }
+      break;
+    case 2: /* UTF-8 has its own decoder */
+      break;
+    default: /* ISO 2022 */
+      if (ctx->ss) break;
+      glset = ctx->gn[ctx->gl];
+      grset = ctx->gn[ctx->gr];
+      gldbl = ctx->gndbl[ctx->gl];
+      grdbl = ctx->gndbl[ctx->gr];
+      for (;p<end;p++) {
+        ch = *p;
+        cls = isoclass[ch];
+        if (cls == IC_CT) *out++ = ch;
+        else if (cls == IC_GL && !gldbl) *out++ = glset | ch;
+        else if (cls == IC_GR && !grdbl) *out++ = grset | (ch & ~0x80);
+        else break;
+        }
+    }
+  ctx->inptr = p;
+  return out;
+}
+
+
+/****************************************************************************
+
+  decfill
+
+  Called by getinchr when decbuf is empty.  Decodes what is left of
+  the input buffer into decbuf, refilling the buffer first only if it
+  is empty.  Returns the number of chars decoded, which is 0 only at
+  the end of input.
+
+****************************************************************************/
+
+static int decfill(figlet_context *ctx)
+{
+  inchr *out,*outend;
+  int ch;
+
+  out = ctx->decbuf;
+  outend = out+ctx->decsize;
+  while (out<outend && ctx->decstate!=DS_EOF) {
+    if (ctx->inptr>=ctx->inend) {
+      if (out>ctx->decbuf) break;  /* no need to wait for more input */
+      ch = inrefill(ctx);
+      }
+    else {
+      if (ctx->decstate==DS_GROUND || ctx->decstate==DS_HZ) {
+        out = decrun(ctx,out,outend);
+        if (out>=outend || ctx->inptr>=ctx->inend) continue;
+        }
+      ch = *ctx->inptr++;
+      }
+    out = decbyte(ctx,ch,out);
+    }
+  ctx->decptr = 0;
+  ctx->decend = out-ctx->decbuf;
+  return ctx->decend;
+}
+
+
+/****************************************************************************
+
+  ungetinchr
+
+  Called by renderloop.  Pushes back an "inchr" to be read by getinchr
+  on the next call.  Any number can be pushed back, to be read last
+  pushed first.  If there is no memory to push it back, it is dropped
+  and nomem set, which ends the render.
+
+******************************************************************************/
+
+static inchr ungetinchr(figlet_context *ctx, inchr c)
+{
+  inchr *buf;
+
+  if (ctx->decptr==0) {
+    if (ctx->decend==ctx->decsize) {
+      if ((buf = (inchr*)figalloc(sizeof(inchr)*ctx->decsize*2))==NULL) {
+        ctx->nomem = 1;
+        return c;
+        }
+      memcpy(buf,ctx->decbuf,sizeof(inchr)*ctx->decend);
+      free(ctx->decbuf);
+      ctx->decbuf = buf;
+      ctx->decsize *= 2;
+      }
+    memmove(ctx->decbuf+1,ctx->decbuf,sizeof(inchr)*ctx->decend);
+    ctx->decptr++;
+    ctx->decend++;
+    }
+  ctx->decbuf[--ctx->decptr] = c;
+  return c;
+}
+
+/****************************************************************************
+
+  getutf8
+
+  Called by getinchr when it cannot decode UTF-8 straight out of the
+  input buffer: when a char runs past the end of the buffer, or is not
+  valid.  Reads the char a byte at a time.  The bad part of a sequence
+  that is not valid, or is cut short by the end of input, is read as
+  0x0080.
+
+****************************************************************************/
+
+static inchr getutf8(figlet_context *ctx)
+{
+  unsigned char seq[4];
+  const unsigned char *p;
+  utf8_cp_t c;
+  int ch,len,n;
+
+  for (len=0;;) {
+    if ((ch = Agetchar(ctx))==EOF) {
+      return len>0 ? 0x0080 : EOF;
+      }
+    seq[len++] = ch;
+    n = utf8_check(seq,seq+len);
+    if (n>0) {
+      p = seq;
+      utf8_decode(&p,seq+len,&c,1);
+      return c;
+      }
+    if (n<0) {
+      if (len>1) {
+        Aungetchar(ctx);  /* may start the next char */
+        }
+      return 0x0080;
+      }
+    }
+}
+
+
+
+/*****************************************************************************
+
+  getinchr
+
+  Called by renderloop.  Processes multibyte characters.  Returns the
+  next char pushed back by ungetinchr or decoded ahead, or else decodes
+  more of the input.
+  If multibyte = 0, ISO 2022 mode (see iso2022 routine).
+  If multibyte = 1,  double-byte mode (0x00-0x7f bytes are characters,
+    0x80-0xFF bytes are first byte of a double-byte character).
+  If multibyte = 2, Unicode UTF-8 mode, as RFC 3629 has it (0x00-0x7F
+    bytes are characters, 0xC2-0xF4 bytes are first byte of a multibyte
+    character of up to 4 bytes, all errors return code 0x0080).
+  If multibyte = 3, HZ mode ("~{" starts double-byte mode, "}~" ends it,
+    "~~" is a tilde, "~x" for all other x is ignored).
+  If multibyte = 4, Shift-JIS mode (0x80-0x9F and 0xE0-0xEF are first byte
+    of a double-byte character, all other bytes are characters).
+
+
+*****************************************************************************/
+
+static inchr getinchr(figlet_context *ctx)
+{
+  if (ctx->decptr<ctx->decend) {
+    return ctx->decbuf[ctx->decptr++];
+    }
+  if (ctx->multibyte==2) { /* UTF-8 */
+    if (ctx->utf8ptr<ctx->utf8end) {
+      return *ctx->utf8ptr++;
+      }
+    ctx->utf8ptr = ctx->utf8buf;
+    ctx->utf8end = ctx->utf8buf+utf8_decode(&ctx->inptr,ctx->inend,
+      ctx->utf8buf,UTF8BUFSIZE);
+    if (ctx->utf8ptr<ctx->utf8end) {
+      return *ctx->utf8ptr++;
+      }
+    return getutf8(ctx);
+    }
+  if (decfill(ctx)==0) {
+    return EOF;
+    }
+  return ctx->decbuf[ctx->decptr++];
+}
+
+/****************************************************************************
+
+  renderloop
+
+  Reads characters 1 by 1 from the input source, and makes lines out
+  of them using addchar. Handles line breaking, (which accounts for
+  most of the complexity in this function).
+
+****************************************************************************/
+
+static void renderloop(figlet_context *ctx)
+{
+  inchr c,c2;
+  int i,len;
+  outchr charrow[MAXLEN+1];
+  int last_was_eol_flag;
+/*---------------------------------------------------------------------------
+  wordbreakmode:
+    -1: /^$/ and blanks are to be absorbed (when line break was forced
+      by a blank or character larger than outlinelenlimit)
+    0: /^ *$/ and blanks are not to be absorbed
+    1: /[^ ]$/ no word break yet
+    2: /[^ ]  *$/
+    3: /[^ ]$/ had a word break
+---------------------------------------------------------------------------*/
+  int wordbreakmode;
+  int char_not_added;
+
+  wordbreakmode = 0;
+  last_was_eol_flag = 0;
+
+  while (!ctx->outerror && !ctx->nomem && (c = getinchr(ctx))!=EOF) {
+
+    if (c=='\n'&&ctx->opts.paragraphflag&&!last_was_eol_flag) {
+      ungetinchr(ctx,c2 = getinchr(ctx));
+      c = ((isascii(c2)&&isspace(c2))?'\n':' ');
+      }
+    last_was_eol_flag = (isascii(c)&&isspace(c)&&c!='\t'&&c!=' ');
+
+    if (ctx->opts.deutschflag) {
+      if (c>='[' && c<=']') {
+        c = deutsch[c-'['];
+        }
+      else if (c >='{' && c <= '~') {
+        c = deutsch[c-'{'+3];
+        }
+      }
+
+    c = handlemapping(ctx,c);
+
+    if (isascii(c)&&isspace(c)) {
+      c = (c=='\t'||c==' ') ? ' ' : '\n';
+      }
+
+    if ((c>'\0' && c<' ' && c!='\n') || c==127) continue;
+
+/*
+  Note: The following code is complex and thoroughly tested.
+  Be careful when modifying!
+*/
+
+    do {
+      char_not_added = 0;
+
+      if (wordbreakmode== -1) {
+        if (c==' ') {
+          break;
+          }
+        else if (c=='\n') {
+          wordbreakmode = 0;
+          break;
+          }
+        wordbreakmode = 0;
+        }
+
+      if (c=='\n') {
+        printline(ctx);
+        wordbreakmode = 0;
+        }
+
+      else if (addchar(ctx,c)) {
+        if (c!=' ') {
+          wordbreakmode = (wordbreakmode>=2)?3:1;
+          }
+        else {
+          wordbreakmode = (wordbreakmode>0)?2:0;
+          }
+        }
+
+      else if (ctx->outlinelen==0) {
+        for (i=0;i<ctx->font->charheight;i++) {
+          len = ctx->curredge[i].len;
+          cellcopy(charrow,ctx,ctx->currchar[i],len);
+          if (ctx->right2left && ctx->outputwidth>1) {
+            putstring(ctx,charrow+len-ctx->outlinelenlimit,
+              ctx->outlinelenlimit);
+            }
+          else {
+            putstring(ctx,charrow,len);
+            }
+          }
+        outflush(ctx);
+        wordbreakmode = -1;
+        }
+
+      else if (c==' ') {
+        if (wordbreakmode==2) {
+          splitline(ctx);
+          }
+        else {
+          printline(ctx);
+          }
+        wordbreakmode = -1;
+        }
+
+      else {
+        if (wordbreakmode>=2) {
+          splitline(ctx);
+          }
+        else {
+          printline(ctx);
+          }
+        wordbreakmode = (wordbreakmode==3)?1:0;
+        char_not_added = 1;
+        }
+
+      } while (char_not_added);
+    }
+
+  if (ctx->outlinelen!=0) {
+    printline(ctx);
+    }
+}
+
+
+/****************************************************************************
+
+  render
+
+  Renders everything the input source set up in the context has, until
+  the end of input, handing the output to out.  Returns FIGLET_OK, or
+  FIGLET_EOUTPUT if out failed, FIGLET_ENOMEM if there was not memory
+  to go on, or FIGLET_EINPUT if reading the input failed (what was
+  read before that is rendered).
+
+****************************************************************************/
+
+static int render(figlet_context *ctx, figlet_outfn out)
+{
+  int i;
+
+  ctx->out = out;
+  ctx->outerror = 0;
+  ctx->nomem = 0;
+  ctx->inerror = 0;
+
+  /* Every render starts in the state set up by the control files */
+  for (i=0;i<4;i++) {
+    ctx->gn[i] = ctx->gn0[i];
+    ctx->gndbl[i] = ctx->gndbl0[i];
+    }
+  ctx->gl = ctx->gl0;
+  ctx->gr = ctx->gr0;
+  ctx->ss = 0;
+  ctx->decstate = DS_GROUND;
+  if (ctx->decbuf==NULL) {
+    if ((ctx->decbuf = (inchr*)figalloc(sizeof(inchr)*DECBUFSIZE))==NULL) {
+      return FIGLET_ENOMEM;
+      }
+    ctx->decsize = DECBUFSIZE;
+    }
+  ctx->decptr = ctx->decend = 0;
+  ctx->utf8ptr = ctx->utf8end = ctx->utf8buf;
+  ctx->currcharwidth = 0;
+  resolveoptions(ctx);
+  if (!smushtabinit(ctx) || (ctx->mapstale && !buildmapping(ctx)) ||
+      !linealloc(ctx)) {
+    ctx->nomem = 1;
+    }
+  else {
+    renderloop(ctx);
+    }
+
+  ctx->inptr = ctx->inend = NULL;
+  ctx->refill = NULL;
+  if (ctx->outerror) {
+    return FIGLET_EOUTPUT;
+    }
+  if (ctx->nomem) {
+    return FIGLET_ENOMEM;
+    }
+  return ctx->inerror ? FIGLET_EINPUT : FIGLET_OK;
+}
+
+
+/****************************************************************************
+
+  inbufalloc
+
+  Allocates the buffer an input stream is read into, if it is not
+  there yet.  Returns false if there is no memory.
+
+****************************************************************************/
+
+static int inbufalloc(figlet_context *ctx)
+{
+  if (ctx->inbuf==NULL) {
+    ctx->inbuf = (unsigned char*)figalloc(INBUFSIZE);
+    }
+  return ctx->inbuf!=NULL;
+}
+
+
+/****************************************************************************
+
+  figlet_render
+
+  Renders a memory buffer, reading it in place.
+
+****************************************************************************/
+
+int figlet_render(figlet_context *ctx, const char *input, size_t len,
+  figlet_outfn out)
+{
+  if (ctx->font==NULL) {
+    return FIGLET_ENOFONTSET;
+    }
+  ctx->inptr = (const unsigned char*)input;
+  ctx->inend = ctx->inptr+len;
+  ctx->refill = NULL;
+  return render(ctx,out);
+}
+
+
+/****************************************************************************
+
+  figlet_render_input
+
+  Renders everything the input callback returns until EOF.  Bytes are
+  taken from the callback a buffer at a time, but never past a
+  newline, so that a line is rendered as soon as it is complete.
+
+****************************************************************************/
+
+static int getcrefill(figlet_context *ctx)
+{
+  unsigned char *p;
+  int c;
+
+  for (p=ctx->inbuf;p<ctx->inbuf+INBUFSIZE;) {
+    if ((c = (*ctx->getbyte)(ctx->getbytearg))==EOF) {
+      break;
+      }
+    *p++ = c;
+    if (c=='\n') {
+      break;
+      }
+    }
+  ctx->inptr = ctx->inbuf;
+  ctx->inend = p;
+  return p>ctx->inbuf;
+}
+
+int figlet_render_input(figlet_context *ctx, figlet_getcfn getbyte,
+  void *arg, figlet_outfn out)
+{
+  if (ctx->font==NULL) {
+    return FIGLET_ENOFONTSET;
+    }
+  if (!inbufalloc(ctx)) {
+    return FIGLET_ENOMEM;
+    }
+  ctx->getbyte = getbyte;
+  ctx->getbytearg = arg;
+  ctx->inptr = ctx->inend = ctx->inbuf;
+  ctx->refill = getcrefill;
+  return render(ctx,out);
+}
+
+
+/****************************************************************************
+
+  figlet_render_fd
+
+  Renders everything read from a file descriptor until end of file.
+  Each read() takes whatever is there, up to a buffer full, so input
+  from a terminal or pipe is rendered as it comes.  A read() that
+  fails, as on a directory, ends the input, and FIGLET_EINPUT is
+  returned.
+
+****************************************************************************/
+
+static int fdrefill(figlet_context *ctx)
+{
+  int n;
+
+  while ((n = read(ctx->infd,ctx->inbuf,INBUFSIZE))<0 && errno==EINTR) ;
+  if (n<=0) {
+    ctx->inerror = n<0;
+    return 0;
+    }
+  ctx->inptr = ctx->inbuf;
+  ctx->inend = ctx->inbuf+n;
+  return 1;
+}
+
+int figlet_render_fd(figlet_context *ctx, int fd, figlet_outfn out)
+{
+  if (ctx->font==NULL) {
+    return FIGLET_ENOFONTSET;
+    }
+  if (!inbufalloc(ctx)) {
+    return FIGLET_ENOMEM;
+    }
+  ctx->infd = fd;
+  ctx->inptr = ctx->inend = ctx->inbuf;
+  ctx->refill = fdrefill;
+  return render(ctx,out);
+}
+
+
+/****************************************************************************
+
+  figlet_render_path
+
+  Renders the named file.  A regular file is mapped into memory and
+  read in place; anything else is read like figlet_render_fd.
+
+****************************************************************************/
+
+int figlet_render_path(figlet_context *ctx, const char *path,
+  figlet_outfn out)
+{
+  int fd,err;
+#ifdef FIG_MMAP
+  struct stat st;
+  void *map;
+#endif
+
+  if (ctx->font==NULL) {
+    return FIGLET_ENOFONTSET;
+    }
+  if ((fd = open(path,O_RDONLY))<0) {
+    return FIGLET_ENOINPUT;
+    }
+#ifdef FIG_MMAP
+  if (fstat(fd,&st)==0 && S_ISREG(st.st_mode) && st.st_size>0 &&
+      (off_t)(size_t)st.st_size==st.st_size &&
+      (map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0))!=MAP_FAILED) {
+    close(fd);
+#ifdef MADV_SEQUENTIAL
+    madvise(map,st.st_size,MADV_SEQUENTIAL);
+#endif
+    err = figlet_render(ctx,(const char*)map,st.st_size,out);
+    munmap(map,st.st_size);
+    return err;
+    }
+#endif
+  err = figlet_render_fd(ctx,fd,out);
+  close(fd);
+  return err;
+}
+
+
+/****************************************************************************
+
+  figlet_render_argv
+
+  Renders words, as the figlet command does its arguments: each word
+  but the last is followed by a blank, or by a newline if it is
+  empty.  The words are read in place.
+
+****************************************************************************/
+
+static int argvrefill(figlet_context *ctx)
+{
+  static const unsigned char sep[] = " \n";
+
+  if (ctx->inargi>=ctx->inargc) {
+    return 0;
+    }
+  if (ctx->inargsep) {
+    ctx->inargsep = 0;
+    ctx->inptr = sep+(ctx->inargv[ctx->inargi-1][0]=='\0');
+    ctx->inend = ctx->inptr+1;
+    return 1;
+    }
+  ctx->inptr = (const unsigned char*)ctx->inargv[ctx->inargi++];
+  ctx->inend = ctx->inptr+strlen((const char*)ctx->inptr);
+  ctx->inargsep = 1;
+  return 1;
+}
+
+int figlet_render_argv(figlet_context *ctx, int argc, char *const argv[],
+  figlet_outfn out)
+{
+  if (ctx->font==NULL) {
+    return FIGLET_ENOFONTSET;
+    }
+  ctx->inargv = argv;
+  ctx->inargc = argc;
+  ctx->inargi = 0;
+  ctx->inargsep = 0;
+  ctx->inptr = ctx->inend = NULL;
+  ctx->refill = argvrefill;
+  return render(ctx,out);
+}
+
+
+/****************************************************************************
+
+  figlet_defaults
+
+  Fills in the options the figlet command uses when given no flags.
+
+****************************************************************************/
+
+void figlet_defaults(figlet_options *opts)
+{
+  opts->smushmode = 0;
+  opts->smushoverride = SMO_NO;
+  opts->right2left = -1;
+  opts->justification = -1;
+  opts->paragraphflag = 0;
+  opts->deutschflag = 0;
+  opts->outputwidth = DEFAULTCOLUMNS;
+}
+
+
+/****************************************************************************
+
+  figlet_new
+
+  Allocates a context with the given options (or the defaults) and
+  no font.  Returns NULL if there is no memory.
+
+****************************************************************************/
+
+figlet_context *figlet_new(const figlet_options *opts)
+{
+  figlet_context *ctx;
+
+  if ((ctx = (figlet_context*)figalloc(sizeof(figlet_context)))==NULL) {
+    return NULL;
+    }
+  memset(ctx,0,sizeof(figlet_context));
+  if (opts!=NULL) {
+    ctx->opts = *opts;
+    }
+  else {
+    figlet_defaults(&ctx->opts);
+    }
+  if (ctx->opts.outputwidth<1) {
+    ctx->opts.outputwidth = DEFAULTCOLUMNS;
+    }
+  ctx->commandlist = NULL;
+  ctx->commandlistend = &ctx->commandlist;
+  ctx->multibyte = 0;
+  ctx->gn0[0] = 0;
+  ctx->gn0[1] = 0x80;
+  ctx->gn0[2] = ctx->gn0[3] = 0;
+  ctx->gl0 = 0;
+  ctx->gr0 = 1;
+  return ctx;
+}
+
+
+/****************************************************************************
+
+  figlet_free
+
+  Releases the context and everything it owns.
+
+****************************************************************************/
+
+void figlet_free(figlet_context *ctx)
+{
+  comnode *cmptr;
+
+  if (ctx==NULL) return;
+  figlet_font_unref(ctx->font);
+  linefree(ctx);
+  while ((cmptr = ctx->commandlist) != NULL) {
+    ctx->commandlist = cmptr->next;
+    free(cmptr);
+    }
+  free(ctx->mapsegs);
+  free(ctx->mapdirect);
+  free(ctx->inbuf);
+  free(ctx->decbuf);
+  free(ctx->smushtab);
+  free(ctx->outbuf);
+  free(ctx);
+}
+
+
+/****************************************************************************
+
+  figlet_set_options
+
+  Replaces the context's options.  They take effect with the next
+  render.
+
+****************************************************************************/
+
+void figlet_set_options(figlet_context *ctx, const figlet_options *opts)
+{
+  ctx->opts = *opts;
+  if (ctx->opts.outputwidth<1) {
+    ctx->opts.outputwidth = DEFAULTCOLUMNS;
+    }
+}
+
+
+/****************************************************************************
+
+  figlet_set_font
+
+  Makes the context render with the given font, taking a reference to
+  it and dropping the one to the previous font.
+
+****************************************************************************/
+
+void figlet_set_font(figlet_context *ctx, figlet_font *font)
+{
+  if (font!=NULL) {
+    figlet_font_ref(font);
+    }
+  figlet_font_unref(ctx->font);
+  ctx->font = font;
+}
+
+
+/****************************************************************************
+
+  figlet_load_font
+
+  Loads a font for this context alone.  Shorthand for figlet_font_load,
+  figlet_set_font and figlet_font_unref.
+
+****************************************************************************/
+
+int figlet_load_font(figlet_context *ctx, const char *fontdir,
+  const char *fontname)
+{
+  figlet_font *font;
+  int err;
+
+  font = figlet_font_load(fontdir,fontname,&err);
+  if (font==NULL) {
+    return err;
+    }
+  figlet_set_font(ctx,font);
+  figlet_font_unref(font);
+  return FIGLET_OK;
+}
+
+
+/****************************************************************************
+
+  figlet_set_userdata
+
+  Sets the pointer passed to the output callback.
+
+****************************************************************************/
+
+void figlet_set_userdata(figlet_context *ctx, void *userdata)
+{
+  ctx->userdata = userdata;
+}
+
+
+/****************************************************************************
+
+  figlet_strerror
+
+  Returns a message for an error code.
+
+****************************************************************************/
+
+const char *figlet_strerror(int err)
+{
+  switch (err) {
+    case FIGLET_OK:
+      return "No error";
+    case FIGLET_ENOFONT:
+      return "Unable to open font file";
+    case FIGLET_EFONTFMT:
+      return "Not a FIGlet 2 font file";
+    case FIGLET_ETOOWIDE:
+      return "character is too wide";
+    case FIGLET_ENOCTRL:
+      return "Unable to open control file";
+    case FIGLET_ENOFONTSET:
+      return "No font loaded";
+    case FIGLET_EOUTPUT:
+      return "Output error";
+    case FIGLET_ENOINPUT:
+      return "Unable to open input file";
+    case FIGLET_EINPUT:
+      return "Error reading input";
+    case FIGLET_ENOMEM:
+      return "Out of memory";
+    default:
+      return "Unknown error";
+    }
+}
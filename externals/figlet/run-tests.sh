@@ -79,6 +79,17 @@ run_test "list of control files" "ls fonts/*flc"
 run_test "uskata control file" "printf 'ABCDE'|$CMD -fbanner -Cuskata"
 run_test "jis0201 control file" "printf '\261\262\263\264\265'|$CMD -fbanner -Cjis0201"
 run_test "right-to-left smushing with JavE font" "$cmd -f tests/flowerpower -R"
+run_test "stacked control files" "printf 'Gr\\374\\337e ab'|$CMD -C8859-2 -Cupper"
+run_test "font cache directory" \
+  "X=.c;mkdir \$X;for i in 1 2; do cat $file|FIGLET_CACHE_DIR=\$X $CMD -f big; done;ls \$X|grep -c flb;rm -Rf \$X"
+run_test "fonts from a zip archive" "$cmd -d tests/fonts.zip -f big -C 646-de"
+run_test "empty control file in a zip archive" "$cmd -d tests/fonts.zip -f big -C empty -C 646-de"
+run_test "font with ragged rows" \
+  "X=.r;mkdir \$X;cat $file|FIGLET_CACHE_DIR=\$X $CMD -f tests/ragged;rm -Rf \$X"
+run_test "ragged rows read lazily and whole alike" \
+  "X=.r;mkdir \$X;cat $file|$CMD -f tests/ragged -R >\$X/lazy;cat $file|FIGLET_CACHE_DIR=\$X $CMD -f tests/ragged -R >\$X/whole;cmp \$X/lazy \$X/whole && cat \$X/lazy;rm -Rf \$X"
+run_test "input file that cannot be read" "$CMD -i tests 2>&1;echo \$?"
+run_test "output that cannot be written" "$CMD hi 2>&1 >/dev/full;echo \$?"
 
 rm -f "$OUTPUT"
 
@@ -1,4 +1,3 @@
-#ifdef TLF_FONTS
 /*
  * Copyright (c) 2007 Alexey Vatchenko <av@bsdua.org>
  *
@@ -16,9 +15,6 @@
  */
 #include <sys/types.h>
 
-#include <wchar.h>
-#include <arpa/inet.h>	/* for htonl() */
-
 #include "utf8.h"
 
 #define _NXT	0x80
@@ -30,31 +26,250 @@
 
 #define _BOM	0xfeff
 
-static int __wchar_forbitten(wchar_t sym);
-static int __utf8_forbitten(u_char octet);
+#if defined(__GNUC__) && defined(__x86_64__)
+#define UTF8_SIMD
+#include <immintrin.h>
+#endif
 
-static int
-__wchar_forbitten(wchar_t sym)
+/*
+ * Decoding, for any build: UTF-8 input is read whether or not TLF fonts
+ * are compiled in.
+ */
+
+/*
+ * Copy a run of ASCII bytes out as code points.  Copies at most n and
+ * stops at the first byte that is not ASCII; returns how many it copied.
+ */
+typedef size_t (*__ascii_fn)(const u_char *, size_t, utf8_cp_t *);
+
+static size_t
+__ascii_scalar(const u_char *p, size_t n, utf8_cp_t *out)
 {
+	size_t i;
 
-	/* Surrogate pairs */
-	if (sym >= 0xd800 && sym <= 0xdfff)
+	for (i = 0; i < n && p[i] < 0x80; i++)
+		out[i] = p[i];
+
+	return (i);
+}
+
+#ifdef UTF8_SIMD
+static size_t
+__ascii_sse2(const u_char *p, size_t n, utf8_cp_t *out)
+{
+	__m128i v, lo, hi, zero;
+	size_t i;
+
+	zero = _mm_setzero_si128();
+	for (i = 0; i + 16 <= n; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(p + i));
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		lo = _mm_unpacklo_epi8(v, zero);
+		hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_si128((__m128i *)(out + i),
+		    _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 4),
+		    _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 8),
+		    _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 12),
+		    _mm_unpackhi_epi16(hi, zero));
+	}
+
+	return (i + __ascii_scalar(p + i, n - i, out + i));
+}
+
+__attribute__((target("avx2")))
+static size_t
+__ascii_avx2(const u_char *p, size_t n, utf8_cp_t *out)
+{
+	__m256i v;
+	size_t i, j;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(p + i));
+		if (_mm256_movemask_epi8(v) != 0)
+			break;
+		for (j = 0; j < 32; j += 8)
+			_mm256_storeu_si256((__m256i *)(out + i + j),
+			    _mm256_cvtepu8_epi32(
+			    _mm_loadl_epi64((const __m128i *)(p + i + j))));
+	}
+
+
+	return (i + __ascii_scalar(p + i, n - i, out + i));
+}
+
+static size_t __ascii_init(const u_char *, size_t, utf8_cp_t *);
+
+/*
+ * The best copy this CPU can run, chosen on first use.  It is loaded
+ * and stored atomically, so that threads may race to choose it: they
+ * all store the same one.
+ */
+static __ascii_fn __ascii_best = __ascii_init;
+
+static size_t
+__ascii_init(const u_char *p, size_t n, utf8_cp_t *out)
+{
+	__ascii_fn fn;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		fn = __ascii_avx2;
+	else
+		fn = __ascii_sse2;
+	__atomic_store_n(&__ascii_best, fn, __ATOMIC_RELAXED);
+	return (fn(p, n, out));
+}
+
+#define __ascii(p, n, out) \
+	(__atomic_load_n(&__ascii_best, __ATOMIC_RELAXED)((p), (n), (out)))
+#else
+#define __ascii __ascii_scalar
+#endif
+
+/*
+ * Check the UTF-8 sequence at p.  Returns its length if it is valid,
+ * 0 if it is valid so far but lim comes first, or -n if it is not
+ * valid, where n is the number of bytes that make up the bad part: the
+ * first byte and any right ones after it.
+ */
+int
+utf8_check(const u_char *p, const u_char *lim)
+{
+	u_char lo, hi;
+	int i, n;
+
+	if (p >= lim)
+		return (0);
+	if (*p < 0x80)
+		return (1);
+
+	/*
+	 * RFC 3629: the ranges the second byte may be in rule out overlong
+	 * forms, surrogates and anything above U+10FFFF.
+	 */
+	lo = 0x80;
+	hi = 0xbf;
+	if (*p >= 0xc2 && *p <= 0xdf)
+		n = 2;
+	else if (*p >= 0xe0 && *p <= 0xef) {
+		n = 3;
+		if (*p == 0xe0)
+			lo = 0xa0;
+		else if (*p == 0xed)
+			hi = 0x9f;
+	} else if (*p >= 0xf0 && *p <= 0xf4) {
+		n = 4;
+		if (*p == 0xf0)
+			lo = 0x90;
+		else if (*p == 0xf4)
+			hi = 0x8f;
+	} else
 		return (-1);
 
-	return (0);
+	for (i = 1; i < n; i++) {
+		if (p + i >= lim)
+			return (0);
+		if (p[i] < lo || p[i] > hi)
+			return (-i);
+		lo = 0x80;
+		hi = 0xbf;
+	}
+
+	return (n);
+}
+
+/*
+ * Decode UTF-8 into code points, up to outsize of them, stopping at the
+ * first sequence that is invalid or runs past lim.  Advances *inp past
+ * what was decoded and returns the number of code points.
+ */
+size_t
+utf8_decode(const u_char **inp, const u_char *lim, utf8_cp_t *out,
+    size_t outsize)
+{
+	const u_char *p;
+	utf8_cp_t *o, *olim, c;
+	int n;
+
+	p = *inp;
+	o = out;
+	olim = out + outsize;
+	while (p < lim && o < olim) {
+		if (*p < 0x80) {
+			/*
+			 * Short runs, as between the words of most scripts,
+			 * are copied here; long ones a block at a time.
+			 */
+			*o++ = *p++;
+			if (lim - p >= 32 && olim - o >= 32 && *p < 0x80 &&
+			    p[1] < 0x80 && p[2] < 0x80 && p[3] < 0x80) {
+				n = __ascii(p, (size_t)(lim - p) <
+				    (size_t)(olim - o) ? (size_t)(lim - p) :
+				    (size_t)(olim - o), o);
+				p += n;
+				o += n;
+			}
+			continue;
+		}
+		/* The common 2- and 3-byte chars first */
+		if (lim - p >= 3 && (p[1] & 0xc0) == _NXT) {
+			if (*p >= 0xc2 && *p <= 0xdf) {
+				*o++ = ((p[0] & 0x1f) << 6) | (p[1] & 0x3f);
+				p += 2;
+				continue;
+			}
+			c = ((utf8_cp_t)(p[0] & 0x0f) << 12) |
+			    ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+			if ((*p & 0xf0) == _SEQ3 && (p[2] & 0xc0) == _NXT &&
+			    c >= 0x800 && (c < 0xd800 || c > 0xdfff)) {
+				*o++ = c;
+				p += 3;
+				continue;
+			}
+		}
+		switch (utf8_check(p, lim)) {
+		case 2:
+			*o++ = ((p[0] & 0x1f) << 6) | (p[1] & 0x3f);
+			p += 2;
+			break;
+		case 3:
+			*o++ = ((utf8_cp_t)(p[0] & 0x0f) << 12) |
+			    ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+			p += 3;
+			break;
+		case 4:
+			*o++ = ((utf8_cp_t)(p[0] & 0x07) << 18) |
+			    ((utf8_cp_t)(p[1] & 0x3f) << 12) |
+			    ((p[2] & 0x3f) << 6) | (p[3] & 0x3f);
+			p += 4;
+			break;
+		default:
+			/* Invalid or incomplete: leave it to the caller */
+			*inp = p;
+			return (o - out);
+		}
+	}
+
+	*inp = p;
+	return (o - out);
 }
 
+#ifdef TLF_FONTS
+#include <arpa/inet.h>	/* for htonl() */
+
+static int __wchar_forbitten(wchar_t sym);
+
 static int
-__utf8_forbitten(u_char octet)
+__wchar_forbitten(wchar_t sym)
 {
 
-	switch (octet) {
-	case 0xc0:
-	case 0xc1:
-	case 0xf5:
-	case 0xff:
+	/* Surrogate pairs */
+	if (sym >= 0xd800 && sym <= 0xdfff)
 		return (-1);
-	}
 
 	return (0);
 }
@@ -78,118 +293,58 @@ __utf8_forbitten(u_char octet)
  * CAVEATS
  *	1. If UTF-8 string contains zero symbols, they will be translated
  *	   as regular symbols.
- *	2. If UTF8_IGNORE_ERROR or UTF8_SKIP_BOM flag is set, sizes may vary
- *	   when `out' is NULL and not NULL. It's because of special UTF-8
- *	   sequences which may result in forbitten (by RFC3629) UNICODE
- *	   characters.  So, the caller must check return value every time and
+ *	2. If UTF8_SKIP_BOM flag is set, sizes may vary when `out' is NULL
+ *	   and not NULL. It's because the BOM is only skipped when it is
+ *	   stored.  So, the caller must check return value every time and
  *	   not prepare buffer in advance (\0 terminate) but after calling this
  *	   function.
+ *	3. The string is validated as RFC3629 says: overlong forms,
+ *	   surrogates, symbols above U+10FFFF and 5- and 6-byte sequences
+ *	   are errors.  If UTF8_IGNORE_ERROR flag is set, they are skipped
+ *	   a byte at a time.
  */
 size_t
 utf8_to_wchar(const char *in, size_t insize, wchar_t *out, size_t outsize,
     int flags)
 {
-	u_char *p, *lim;
-	wchar_t *wlim, high;
-	size_t n, total, i, n_bits;
+	const u_char *p, *lim;
+	utf8_cp_t buf[256];
+	wchar_t *wlim;
+	size_t n, i, total;
 
 	if (in == NULL || insize == 0 || (outsize == 0 && out != NULL))
 		return (0);
 
 	total = 0;
-	p = (u_char *)in;
+	p = (const u_char *)in;
 	lim = p + insize;
 	wlim = out + outsize;
 
-	for (; p < lim; p += n) {
-		if (__utf8_forbitten(*p) != 0 &&
-		    (flags & UTF8_IGNORE_ERROR) == 0)
-			return (0);
-
-		/*
-		 * Get number of bytes for one wide character.
-		 */
-		n = 1;	/* default: 1 byte. Used when skipping bytes. */
-		if ((*p & 0x80) == 0)
-			high = (wchar_t)*p;
-		else if ((*p & 0xe0) == _SEQ2) {
-			n = 2;
-			high = (wchar_t)(*p & 0x1f);
-		} else if ((*p & 0xf0) == _SEQ3) {
-			n = 3;
-			high = (wchar_t)(*p & 0x0f);
-		} else if ((*p & 0xf8) == _SEQ4) {
-			n = 4;
-			high = (wchar_t)(*p & 0x07);
-		} else if ((*p & 0xfc) == _SEQ5) {
-			n = 5;
-			high = (wchar_t)(*p & 0x03);
-		} else if ((*p & 0xfe) == _SEQ6) {
-			n = 6;
-			high = (wchar_t)(*p & 0x01);
-		} else {
+	while (p < lim) {
+		n = utf8_decode(&p, lim, buf, sizeof(buf) / sizeof(buf[0]));
+		if (n == 0) {
+			/* invalid or truncated sequence: skip a byte */
 			if ((flags & UTF8_IGNORE_ERROR) == 0)
 				return (0);
+			p++;
 			continue;
 		}
 
-		/* does the sequence header tell us truth about length? */
-		if (lim - p <= n - 1) {
-			if ((flags & UTF8_IGNORE_ERROR) == 0)
-				return (0);
-			n = 1;
-			continue;	/* skip */
-		}
-
-		/*
-		 * Validate sequence.
-		 * All symbols must have higher bits set to 10xxxxxx
-		 */
-		if (n > 1) {
-			for (i = 1; i < n; i++) {
-				if ((p[i] & 0xc0) != _NXT)
-					break;
-			}
-			if (i != n) {
-				if ((flags & UTF8_IGNORE_ERROR) == 0)
-					return (0);
-				n = 1;
-				continue;	/* skip */
-			}
-		}
-
-		total++;
-
-		if (out == NULL)
+		if (out == NULL) {
+			total += n;
 			continue;
-
-		if (out >= wlim)
-			return (0);		/* no space left */
-
-		*out = 0;
-		n_bits = 0;
-		for (i = 1; i < n; i++) {
-			*out |= (wchar_t)(p[n - i] & 0x3f) << n_bits;
-			n_bits += 6;		/* 6 low bits in every byte */
 		}
-		*out |= high << n_bits;
-
-		if (*out == 0)			/* return at end of string */
-			break;
 
-		if (__wchar_forbitten(*out) != 0) {
-			if ((flags & UTF8_IGNORE_ERROR) == 0)
-				return (0);	/* forbitten character */
-			else {
-				total--;
-				out--;
-			}
-		} else if (*out == _BOM && (flags & UTF8_SKIP_BOM) != 0) {
-			total--;
-			out--;
+		for (i = 0; i < n; i++) {
+			if (buf[i] == _BOM && (flags & UTF8_SKIP_BOM) != 0)
+				continue;
+			if (out >= wlim)
+				return (0);		/* no space left */
+			*out++ = (wchar_t)buf[i];
+			total++;
+			if (buf[i] == 0)	/* return at end of string */
+				return (total);
 		}
-
-		out++;
 	}
 
 	return (total);
@@ -21,8 +21,22 @@
 #define _UTF8_H_
 
 #include <sys/types.h>
+#include <limits.h>
 
+#ifdef TLF_FONTS
 #include <wchar.h>
+#endif
+
+#ifdef __TURBOC__
+typedef unsigned char	u_char;		/* not in its <sys/types.h> */
+#endif
+
+/* A decoded code point: more than an int of 16 bits holds */
+#if UINT_MAX < 0x10ffff
+typedef unsigned long	utf8_cp_t;
+#else
+typedef unsigned int	utf8_cp_t;
+#endif
 
 #define UTF8_IGNORE_ERROR		0x01
 #define UTF8_SKIP_BOM			0x02
@@ -31,10 +45,15 @@
 extern "C" {
 #endif
 
+int		utf8_check(const u_char *p, const u_char *lim);
+size_t		utf8_decode(const u_char **inp, const u_char *lim,
+		    utf8_cp_t *out, size_t outsize);
+#ifdef TLF_FONTS
 size_t		utf8_to_wchar(const char *in, size_t insize, wchar_t *out,
 		    size_t outsize, int flags);
 size_t		wchar_to_utf8(const wchar_t *in, size_t insize, char *out,
 		    size_t outsize, int flags);
+#endif
 
 #ifdef   __cplusplus
 }
@@ -71,12 +71,28 @@
  *
  * These fields are described in more detail in appnote.txt
  * in the pkzip 1.93 distribution.
+ *
+ * To find a file by name in an archive of many, the central
+ * directory at the end of the archive is used.  It is found from
+ * the end of central directory record, the last 22 bytes of the
+ * archive (if there is no archive comment):
+ *
+ *      end of central dir signature    4 bytes  (0x06054b50)
+ *      (disk numbers, entry counts)    8 bytes
+ *      size of the central directory   4 bytes
+ *      offset of the central directory 4 bytes
+ *      zipfile comment length          2 bytes
+ *
+ * The central directory has an entry for each file, with the
+ * same fields as its local header (at offset 4 onwards, after a
+ * "version made by" field), then a comment length, other fields
+ * the archive reader has no need of, and at offset 42 the offset
+ * of its local header, followed by the filename.
  */
 
 #include <stdlib.h>
-#ifdef MEMCPY
-#include <mem.h>
-#endif
+#include <string.h>
+#include <limits.h>
 
 #include "zipio.h"
 #include "inflate.h"
@@ -102,6 +118,14 @@
 #define ZIPSIGNATURE     0x04034b50L
 #endif
 
+#ifndef DIRSIGNATURE
+#define DIRSIGNATURE     0x02014b50L
+#endif
+
+#ifndef ENDSIGNATURE
+#define ENDSIGNATURE     0x06054b50L
+#endif
+
 #ifndef SEEK_SET
 #define SEEK_SET	0
 #endif
@@ -114,6 +138,39 @@
 #define SEEK_END	2
 #endif
 
+/*
+ * Macro to enable mapping of uncompressed files (systems with mmap)
+ */
+
+#ifndef MAPENABLE
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#define MAPENABLE 1
+#else
+#define MAPENABLE 0
+#endif
+#endif
+
+#if MAPENABLE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+/*
+ * Macros to count the holders of an archive, which may be files
+ * closed by different threads
+ */
+
+#if defined(__GNUC__)
+#define REFINC(x) __sync_add_and_fetch(&(x), 1)
+#define REFDEC(x) __sync_sub_and_fetch(&(x), 1)
+#else
+#define REFINC(x) (++(x))
+#define REFDEC(x) (--(x))
+#endif
+
 
 /* 
  * Buffer size macros
@@ -125,6 +182,10 @@
  * The constant BUFFERTHRESHOLD determines when memory
  * buffering changes to file buffering.
  *
+ * The constant MAPTHRESHOLD determines when an uncompressed
+ * file is mapped rather than read whole into memory; mapping
+ * costs more than reading a small file.
+ *
  * Assumptions:
  *
  *   1) INPBUFSIZE + OUTBUFSIZE + sizeof(void *) * PTRBUFSIZE + delta < 64K
@@ -140,6 +201,10 @@
 #define BUFFERTHRESHOLD            (256 * 1024L)
 #endif
 
+#ifndef MAPTHRESHOLD
+#define MAPTHRESHOLD               (128 * 1024L)
+#endif
+
 #ifndef INPBUFSIZE
 #define INPBUFSIZE                 (  8 * 1024 )
 #endif
@@ -162,6 +227,10 @@
 
 /*
  * Macro to manipulate Zgetc() cache
+ *
+ * The cache is in getbuf, in a window held from inflate when
+ * streaming, or all of a file held whole; cachebase is where, and
+ * cachepos its file position.
  */
 
 #define CACHEINIT                                 \
@@ -171,8 +240,8 @@
 #define CACHEUPDATE                               \
   if (ZS->ptr)                                    \
   {                                               \
-    ZS->fileposition &= ~((long) (OUTBUFSIZE-1)); \
-    ZS->fileposition += ZS->ptr - ZS->getbuf;     \
+    ZS->fileposition  = ZS->cachepos;             \
+    ZS->fileposition += ZS->ptr - ZS->cachebase;  \
     ZS->ptr = NULL;                               \
   }                                               \
   ZS->len = 0;
@@ -236,6 +305,24 @@ struct ZipioState {
   unsigned char  getbuf[OUTBUFSIZE];         /* buffer for use by Zgetc    */
   long           getoff;                     /* starting offset of getbuf  */
 
+  unsigned char *cachebase;                  /* buffer Zgetc cache is in   */
+  unsigned long  cachepos;                   /* file position of cachebase */
+
+  unsigned char *mapbuf;                     /* all of an unzipped file    */
+  int            mapped;                     /* mapbuf is mapped, not read */
+
+  /* Streaming state (mode "rbs"), reading straight from inflate */
+  int            streaming;                  /* streaming, not buffering   */
+  unsigned char *holdbuf;                    /* window held from inflate   */
+  long           holdlen;                    /* length of it               */
+  unsigned char *inpptr;                     /* input not yet inflated:    */
+  int            inplen;                     /* pointer and length         */
+  long           dataoff;                    /* where the deflated data is */
+
+  /* Archive state, if a file in a held archive (Zopen_member) */
+  struct ZipArchive *archive;                /* archive the file is in     */
+  unsigned char *inpmem;                     /* deflated data in it        */
+
   FILE          *tmpfil;                     /* file ptr to temp file      */
 
   /* Amount of input data inflated */
@@ -267,6 +354,107 @@ struct ZipioState {
   unsigned long  runtimetypeid2;             /* to detect run-time errors  */
 };
 
+/* Structure to hold an index entry for a file in a zip archive */
+struct ZipMember {
+  char          *name;     /* filename (NUL terminated)                */
+  unsigned long  offs;     /* offset of local file header              */
+  unsigned int   flag;     /* general purpose bit flag                 */
+  unsigned int   comp;     /* compression method                       */
+  unsigned long  crc3;     /* crc-32                                   */
+  unsigned long  csiz;     /* compressed size                          */
+  unsigned long  usiz;     /* uncompressed size                        */
+};
+
+/* Structure to hold a zip archive, and the index of the files in it */
+struct ZipArchive {
+  unsigned char    *buf;                     /* all of the archive         */
+  unsigned long     len;                     /* length of it               */
+  int               mapped;                  /* buf is mapped, not read    */
+
+  int               count;                   /* number of files            */
+  struct ZipMember *members;                 /* the files, sorted by name  */
+  char             *names;                   /* their names                */
+
+  int               refcount;                /* opener and open files      */
+};
+
+/*
+ * Utility routines to hold all of a file in memory
+ */
+
+/* Map (if big) or read (if small) all of a regular file */
+static unsigned char *HoldFile(
+  FILE *fp,
+  unsigned long *lenp,
+  int *mappedp
+)
+{
+  void *buf;
+  long len;
+
+#if MAPENABLE
+  struct stat st;
+
+  /* Only take regular files that the Zgetc cache length can span */
+  if (fstat(fileno(fp), &st)) return NULL;
+  if (!S_ISREG(st.st_mode))   return NULL;
+  if (st.st_size <= 0)        return NULL;
+  if (st.st_size >  INT_MAX)  return NULL;
+
+  len = (long) st.st_size;
+
+  /* Map a big file; read a small one into memory in one go */
+  if (len >= MAPTHRESHOLD)
+  {
+    buf = mmap(NULL, (size_t) len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (buf == MAP_FAILED) return NULL;
+
+    *lenp    = (unsigned long) len;
+    *mappedp = TRUE;
+    return (unsigned char *) buf;
+  }
+#else
+  /* Get the file size */
+  if (fseek(fp, 0, SEEK_END)) return NULL;
+  len = ftell(fp);
+  if (fseek(fp, 0, SEEK_SET)) return NULL;
+
+  if ((len <= 0) || (len > INT_MAX)) return NULL;
+#endif
+
+  buf = malloc((size_t) len);
+  if (!buf) return NULL;
+
+  if (fread(buf, 1, (size_t) len, fp) != (size_t) len)
+  {
+    free(buf);
+    fseek(fp, 0, SEEK_SET);
+    return NULL;
+  }
+
+  *lenp    = (unsigned long) len;
+  *mappedp = FALSE;
+  return (unsigned char *) buf;
+}
+
+/* Free a file held by HoldFile */
+static void HoldFree(
+  unsigned char *buf,
+  unsigned long len,
+  int mapped
+)
+{
+#if MAPENABLE
+  if (mapped)
+  {
+    munmap((void *) buf, (size_t) len);
+    return;
+  }
+#endif
+
+  free(buf);
+}
+
 /*
  * Utility routines to handle uncompressed file buffers
  */
@@ -298,7 +486,7 @@ static void BufferInitialize(
   }
 
   /* If there's no file open, see if it's big enough for temp file */
-  if (!zs->tmpfil)
+  if (!zs->tmpfil && !zs->streaming)
   {
     if (zs->usiz >= BUFFERTHRESHOLD)
       zs->tmpfil = tmpfile();
@@ -314,10 +502,38 @@ static void BufferInitialize(
   }
 }
 
+/* Get the next length bytes of input, from the archive or the file */
+static unsigned char *InputRead(
+  struct ZipioState *zs,
+  size_t length
+)
+{
+  unsigned char *ptr;
+
+  /* If in a held archive, just point at it */
+  if (zs->inpmem)
+  {
+    ptr = zs->inpmem + zs->inpinf;
+  }
+  /* Otherwise, read it from the file */
+  else
+  {
+    if (fread(zs->inpbuf, 1, length, zs->OpenFile) != length) return NULL;
+
+    ptr = zs->inpbuf;
+  }
+
+  /* Update how much data has been read */
+  zs->inpinf += length;
+
+  return ptr;
+}
+
 /* pump data till length bytes of file are inflated or error encountered */
 static int BufferPump(struct ZipioState *zs, long length)
 {
-  size_t inplen, ret;
+  size_t inplen;
+  unsigned char *inp;
 
   /* Check to see if the length is valid */
   if (length > zs->usiz) return TRUE;
@@ -334,14 +550,11 @@ static int BufferPump(struct ZipioState *zs, long length)
     if (inplen <= 0) return TRUE;
 
     /* Read some data from the file */
-    ret = fread(zs->inpbuf, 1, inplen, zs->OpenFile);
-    if (ret != inplen) return TRUE;
-
-    /* Update how much data has been read from the file */
-    zs->inpinf += inplen;
+    inp = InputRead(zs, inplen);
+    if (!inp) return TRUE;
 
     /* Pump this data into the decompressor */
-    if (InflatePutBuffer(zs->inflatestate, zs->inpbuf, inplen)) return TRUE;
+    if (InflatePutBuffer(zs->inflatestate, inp, inplen)) return TRUE;
   }
 
   return FALSE;
@@ -405,12 +618,7 @@ static int BufferRead(
       ptr += off;
 
       /* Copy the data for this block */
-#ifdef MEMCPY
       memcpy(tmpbuf, ptr, len);
-#else
-      for (i=0; i<len; i++)
-        tmpbuf[i] = ptr[i];
-#endif
 
       /* Update the offset, buffer, and length */
       tmpoff += len;
@@ -477,12 +685,7 @@ static int BufferAppend(
       ptr += off;
 
       /* Copy the data for this block */
-#ifdef MEMCPY
       memcpy(ptr, tmpbuf, len);
-#else
-      for (i=0; i<len; i++)
-        ptr[i] = tmpbuf[i];
-#endif
 
       /* Update the offset, buffer, and length */
       tmpoff += len;
@@ -503,8 +706,15 @@ static void BufferTerminate(
   struct ZipioState *zs
 )
 {
+  /* If holding all of the uncompressed file, free it (unless archived) */
+  if (zs->mapbuf)
+  {
+    if (!zs->archive) HoldFree(zs->mapbuf, zs->usiz, zs->mapped);
+    zs->mapbuf = NULL;
+  }
+  else
   /* If reading directly from the uncompressed file, just mark with NULL */
-  if (zs->tmpfil == zs->OpenFile)
+  if (zs->tmpfil && (zs->tmpfil == zs->OpenFile))
   {
     zs->tmpfil = NULL;
   }
@@ -524,6 +734,49 @@ static void BufferTerminate(
   }
 }
 
+#if MAPENABLE
+/* Hold all of the file, if it is a regular file and not a zip file */
+static int MapInitialize(
+  struct ZipioState *zs
+)
+{
+  unsigned char *buf;
+  unsigned char head[4];
+  unsigned long len, sign;
+  int mapped;
+
+  /* Leave anything that might be a zip file to be read normally; */
+  /* only its signature is read here, so it is still read once    */
+  if (pread(fileno(zs->OpenFile), head, 4, 0) == 4)
+  {
+    GETUINT4(head, sign);
+    if (sign == ZIPSIGNATURE) return FALSE;
+  }
+
+  buf = HoldFile(zs->OpenFile, &len, &mapped);
+  if (!buf) return FALSE;
+
+  /* All of the file is held, so the file can be closed */
+  fclose(zs->OpenFile);
+  zs->OpenFile = NULL;
+
+  zs->mapbuf = buf;
+  zs->mapped = mapped;
+  zs->usiz   = len;
+  zs->outinf = zs->usiz;
+  zs->getoff = -1;
+  zs->tmpfil = NULL;
+
+  /* Make the Zgetc cache all of the file */
+  zs->cachebase = zs->mapbuf;
+  zs->cachepos  = 0;
+  zs->ptr       = zs->mapbuf;
+  zs->len       = (int) zs->usiz;
+
+  return TRUE;
+}
+#endif
+
 /*
  * callout routines for InflateInitialize
  */
@@ -542,6 +795,15 @@ static int inflate_putbuffer(             /* returns 0 on success       */
   /* Update the CRC */
   ZS->filecrc = CrcUpdate(ZS->filecrc, buffer, length);
 
+  /* If streaming, hold on to the window till it has been read */
+  if (ZS->streaming)
+  {
+    ZS->holdbuf  = buffer;
+    ZS->holdlen  = length;
+    ZS->outinf  += length;
+    return -1;
+  }
+
   /* Append to the buffer */
   if (BufferAppend(ZS, buffer, length)) return TRUE;
 
@@ -559,11 +821,140 @@ static void inflate_free(void *buffer)
   free(buffer);
 }
 
-ZFILE *Zopen(const char *path, const char *mode)
+/*
+ * Utility routines to stream inflated files
+ *
+ * Each window inflate puts out is held, and read from in place,
+ * till reading goes past it; then inflate is given more input till
+ * it puts out the next.  Reading from before the held window starts
+ * inflating again from the beginning, with buffering.
+ */
+
+/* Inflate till the next window is held or error encountered */
+static int StreamPump(struct ZipioState *zs)
 {
-  struct ZipioState *zs;
+  long taken;
 
-  long inplen;
+  while (!zs->errorencountered)
+  {
+    /* Read some more data from the file, if it has all been taken */
+    if ((zs->inplen == 0) && (zs->inpinf < zs->csiz))
+    {
+      if ((zs->csiz - zs->inpinf) < INPBUFSIZE)
+        zs->inplen = (int) (zs->csiz - zs->inpinf);
+      else
+        zs->inplen = INPBUFSIZE;
+
+      zs->inpptr = InputRead(zs, zs->inplen);
+      if (!zs->inpptr) return TRUE;
+    }
+
+    /* Pump what is left of it into the decompressor */
+    zs->holdlen = 0;
+    taken = InflatePutBufferSome(zs->inflatestate,
+                                 zs->inpptr,
+                                 zs->inplen);
+    if (taken < 0) return TRUE;
+
+    zs->inpptr += taken;
+    zs->inplen -= (int) taken;
+
+    if (zs->holdlen > 0) return FALSE;
+
+    /* Stop if nothing was taken or put out: the data ended early */
+    if (taken == 0) return TRUE;
+  }
+
+  return TRUE;
+}
+
+/* Start inflating again from the beginning, buffering this time */
+static int StreamRestart(struct ZipioState *zs)
+{
+  InflateTerminate(zs->inflatestate);
+
+  zs->streaming = FALSE;
+  zs->holdlen   = 0;
+  zs->inplen    = 0;
+  zs->inpinf    = 0;
+  zs->outinf    = 0;
+  zs->filecrc   = 0xffffffffL;
+
+  /* (an archived file is read from memory, so needs no seek) */
+  if (!zs->inpmem && fseek(zs->OpenFile, zs->dataoff, SEEK_SET))
+    return TRUE;
+
+  BufferInitialize(zs, TRUE);
+
+  zs->inflatestate = InflateInitialize(
+                       (void *) zs,
+                       inflate_putbuffer,
+                       inflate_malloc,
+                       inflate_free
+                     );
+  if (!zs->inflatestate) return TRUE;
+
+  return FALSE;
+}
+
+/* Hold the window with the file position in it (if still streaming) */
+static int StreamFind(struct ZipioState *zs)
+{
+  /* If it is before the held window, start again, buffering */
+  if (zs->fileposition < zs->outinf - zs->holdlen)
+    return StreamRestart(zs);
+
+  /* Inflate till it is in the held window */
+  while (zs->fileposition >= zs->outinf)
+    if (StreamPump(zs)) return TRUE;
+
+  return FALSE;
+}
+
+/* Read from the stream at the file position, and move past it */
+static int StreamRead(
+  struct ZipioState *zs,
+  unsigned char *buffer,
+  long length
+)
+{
+  long off, len;
+  unsigned char *ptr;
+
+  while (length)
+  {
+    if (StreamFind(zs)) return TRUE;
+
+    /* If no longer streaming, read the rest from the buffer */
+    if (!zs->streaming)
+    {
+      if (BufferRead(zs, zs->fileposition, buffer, length)) return TRUE;
+      zs->fileposition += length;
+      return FALSE;
+    }
+
+    /* Get the offset,length in the held window */
+    off = zs->fileposition - (zs->outinf - zs->holdlen);
+    len = zs->holdlen - off;
+    if (len > length) len = length;
+
+    /* Copy the data from it */
+    ptr = zs->holdbuf + off;
+    memcpy(buffer, ptr, len);
+
+    /* Update the file position, buffer, and length */
+    zs->fileposition += len;
+    buffer           += len;
+    length           -= len;
+  }
+
+  return FALSE;
+}
+
+/* Allocate a ZipioState, and set up its initial values */
+static struct ZipioState *StateAllocate(void)
+{
+  struct ZipioState *zs;
 
   /* Allocate the ZipioState memory area */
   zs = (struct ZipioState *) malloc(sizeof(struct ZipioState));
@@ -584,14 +975,63 @@ ZFILE *Zopen(const char *path, const char *mode)
 
   zs->filecrc          = 0xffffffffL;
 
+  zs->streaming        = FALSE;
+  zs->holdlen          = 0;
+  zs->inplen           = 0;
+
+  zs->mapbuf           = NULL;
+
+  zs->archive          = NULL;
+  zs->inpmem           = NULL;
+
+  zs->OpenFile         = NULL;
+  zs->inflatestate     = NULL;
+
+  return zs;
+}
+
+ZFILE *Zopen(const char *path, const char *mode)
+{
+  struct ZipioState *zs;
+
+  long inplen;
+
+  char fmode[8];
+  int  i, streaming;
+
+  /* Take "s" out of the mode: it asks for streaming */
+  streaming = FALSE;
+  for (i=0; *mode && i<(int)sizeof(fmode)-1; mode++)
+  {
+    if (*mode == 's')
+      streaming = TRUE;
+    else
+      fmode[i++] = *mode;
+  }
+  fmode[i] = '\0';
+
+  /* Allocate the ZipioState memory area */
+  zs = StateAllocate();
+  if (!zs) return NULL;
+
   /* Open the real file */
-  zs->OpenFile = fopen(path, mode);
+  zs->OpenFile = fopen(path, fmode);
   if (!zs->OpenFile)
   {
     free(zs);
     return NULL;
   }
 
+#if MAPENABLE
+  /* If it isn't a zip file, hold all of it, with no sniffing read */
+  if (MapInitialize(zs))
+  {
+    zs->inflatestate = NULL;
+
+    return (ZFILE *) zs;
+  }
+#endif
+
   /* Read the first input buffer */
   if ((inplen = (long) fread(zs->inpbuf, 1, INPBUFSIZE, zs->OpenFile)) >= 30)
   {
@@ -641,7 +1081,10 @@ ZFILE *Zopen(const char *path, const char *mode)
   }
   else
   {
-    /* Initialize buffering */
+    /* Initialize buffering (none but the Zgetc cache if streaming) */
+    zs->streaming = streaming;
+    zs->dataoff   = 30+zs->flen+zs->elen;
+
     BufferInitialize(zs, TRUE);
 
     zs->inflatestate = InflateInitialize(
@@ -651,11 +1094,18 @@ ZFILE *Zopen(const char *path, const char *mode)
                          inflate_free
                        );
 
-    if (InflatePutBuffer(zs->inflatestate,
-                         zs->inpbuf+30+zs->flen+zs->elen,
-                             inplen-30-zs->flen-zs->elen
-                        )
-       )
+    /* If streaming, leave the input to be inflated as it is read */
+    if (zs->streaming)
+    {
+      zs->inpptr = zs->inpbuf + zs->dataoff;
+      zs->inplen = (int) (inplen-zs->dataoff);
+      if (zs->inplen > zs->csiz) zs->inplen = (int) zs->csiz;
+    }
+    else if (InflatePutBuffer(zs->inflatestate,
+                              zs->inpbuf+30+zs->flen+zs->elen,
+                                  inplen-30-zs->flen-zs->elen
+                             )
+            )
       zs->errorencountered = TRUE;
 
     zs->inpinf += inplen-30-zs->flen-zs->elen;
@@ -680,6 +1130,35 @@ int _Zgetc(ZFILE *stream)
   /* If already at EOF, return */
   if (ZS->fileposition >= ZS->usiz) return -1;
 
+  /* If all the file is held, the cache is the rest of it */
+  if (ZS->mapbuf)
+  {
+    ZS->cachebase = ZS->mapbuf;
+    ZS->cachepos  = 0;
+
+    ZS->len = (int) (ZS->usiz - ZS->fileposition);
+    ZS->ptr = ZS->mapbuf + ZS->fileposition;
+
+             ZS->len--;
+    return *(ZS->ptr++);
+  }
+
+  /* If streaming, use the window with the data in it as the cache */
+  if (ZS->streaming && StreamFind(ZS)) return -1;
+
+  if (ZS->streaming)
+  {
+    ZS->cachebase = ZS->holdbuf;
+    ZS->cachepos  = ZS->outinf - ZS->holdlen;
+
+    off = (int) (ZS->fileposition - ZS->cachepos);
+    ZS->len = (int) (ZS->holdlen - off);
+    ZS->ptr = ZS->holdbuf + off;
+
+             ZS->len--;
+    return *(ZS->ptr++);
+  }
+
   /* If data isn't in current outbuf, get it */
   offset = ZS->fileposition & ~((long) (OUTBUFSIZE-1));
   length = ZS->usiz - offset;
@@ -693,6 +1172,9 @@ int _Zgetc(ZFILE *stream)
   }
 
   /* Set up the cache */
+  ZS->cachebase = ZS->getbuf;
+  ZS->cachepos  = offset;
+
   off = (int) (ZS->fileposition & (OUTBUFSIZE-1));
   ZS->len = (int) (length - off);
   ZS->ptr = ZS->getbuf    + off;
@@ -729,12 +1211,28 @@ size_t Zread(void *ptr, size_t size, size_t n, ZFILE *stream)
   /* If the length is zero, then just return an EOF error */
   if (length <= 0) return 0;
 
-  /* Read from the buffer */
-  if (BufferRead(ZS, ZS->fileposition, (unsigned char *) ptr, length))
-    return 0;
+  /* If all the file is held, copy straight from it */
+  if (ZS->mapbuf)
+  {
+    memcpy(ptr, ZS->mapbuf + ZS->fileposition, (size_t) length);
+
+    /* Update the file position */
+    ZS->fileposition += length;
+  }
+  /* If streaming, read from the stream, which updates the file position */
+  else if (ZS->streaming)
+  {
+    if (StreamRead(ZS, (unsigned char *) ptr, length)) return 0;
+  }
+  else
+  {
+    /* Read from the buffer */
+    if (BufferRead(ZS, ZS->fileposition, (unsigned char *) ptr, length))
+      return 0;
 
-  /* Update the file position */
-  ZS->fileposition += length;
+    /* Update the file position */
+    ZS->fileposition += length;
+  }
 
   /* Return the number of items transferred */
   return (size_t) (length / size);
@@ -793,6 +1291,21 @@ int Zclose(ZFILE *stream)
 
   CACHEUPDATE;
 
+  /* If streaming, inflate the rest, so that the end can be checked */
+  if (ZS->streaming)
+    while (!ZS->errorencountered && !StreamPump(ZS))
+      ;
+  /* Likewise if all of the input is in memory, as in an archive */
+  else if (ZS->inpmem && ZS->inflatestate && !ZS->errorencountered &&
+           (ZS->inpinf < ZS->csiz))
+  {
+    long inplen = ZS->csiz - ZS->inpinf;
+
+    if (InflatePutBuffer(ZS->inflatestate,
+                         InputRead(ZS, (size_t) inplen), inplen))
+      ZS->errorencountered = TRUE;
+  }
+
   /* terminate the inflate routines, and check for errors */
   if (ZS->inflatestate)
   {
@@ -807,12 +1320,303 @@ int Zclose(ZFILE *stream)
   /* save the final error status */
   ret = ZS->errorencountered;
 
-  /* terminate the buffering */
+  /* terminate the buffering, and close the file */
   BufferTerminate(ZS);
 
+  if (ZS->OpenFile) fclose(ZS->OpenFile);
+
+  /* let go of the archive the file is in, if any */
+  if (ZS->archive) Zarchive_close(ZS->archive);
+
   /* free the ZipioState structure */
   free(ZS);
 
   /* return the final error status */
   return ret;
 }
+
+/*
+ * Routines to read the files in an archive of many
+ */
+
+/* Compare the names of two files in an archive */
+static int MemberCompare(const void *a, const void *b)
+{
+  return strcmp(((const struct ZipMember *) a)->name,
+                ((const struct ZipMember *) b)->name);
+}
+
+/* Find a file in an archive by name, or else by its last component */
+static struct ZipMember *MemberFind(ZARCHIVE *archive, const char *name)
+{
+  struct ZipMember key, *zm;
+  size_t namelen, len;
+  int i;
+
+  key.name = (char *) name;
+  zm = (struct ZipMember *) bsearch(&key, archive->members,
+                                    (size_t) archive->count,
+                                    sizeof(struct ZipMember),
+                                    MemberCompare);
+  if (zm) return zm;
+
+  /* Try for it in a directory in the archive, as in "dir/name" */
+  namelen = strlen(name);
+  for (i=0; i<archive->count; i++)
+  {
+    zm  = archive->members + i;
+    len = strlen(zm->name);
+
+    if ((len > namelen) && (zm->name[len-namelen-1] == '/') &&
+        !strcmp(zm->name+len-namelen, name))
+      return zm;
+  }
+
+  return NULL;
+}
+
+ZARCHIVE *Zarchive_open(const char *path)
+{
+  struct ZipArchive *za;
+  FILE *fp;
+
+  unsigned char *ptr, *end;
+  unsigned long sign, cdsiz, cdoff, offs;
+  unsigned int  flen, elen, clen;
+  long namesiz;
+  int count, i;
+
+  /* Allocate the ZipArchive memory area */
+  za = (struct ZipArchive *) malloc(sizeof(struct ZipArchive));
+  if (!za) return NULL;
+
+  za->count    = 0;
+  za->members  = NULL;
+  za->names    = NULL;
+  za->refcount = 1;
+
+  /* Hold all of the archive; the file is then of no more use */
+  fp = fopen(path, "rb");
+  if (!fp)
+  {
+    free(za);
+    return NULL;
+  }
+
+  za->buf = HoldFile(fp, &za->len, &za->mapped);
+  fclose(fp);
+
+  if (!za->buf)
+  {
+    free(za);
+    return NULL;
+  }
+
+  /* Find the end of central directory record, before any comment */
+  sign = 0;
+  ptr  = NULL;
+  if (za->len >= 22)
+  {
+    for (ptr = za->buf + za->len - 22; ; ptr--)
+    {
+      GETUINT4(ptr, sign);
+      if ((sign == ENDSIGNATURE) ||
+          (ptr == za->buf) || (za->buf + za->len - ptr >= 22 + 65535L))
+        break;
+    }
+  }
+
+  if (sign != ENDSIGNATURE)
+  {
+    Zarchive_close(za);
+    return NULL;
+  }
+
+  GETUINT4(ptr+12, cdsiz);
+  GETUINT4(ptr+16, cdoff);
+  if ((cdoff > za->len) || (cdsiz > za->len - cdoff))
+  {
+    Zarchive_close(za);
+    return NULL;
+  }
+
+  /* Count the entries, and the room their names need */
+  count   = 0;
+  namesiz = 0;
+  end = za->buf + cdoff + cdsiz;
+  for (ptr = za->buf + cdoff; end - ptr >= 46; ptr += 46+flen+elen+clen)
+  {
+    GETUINT4(ptr   , sign);
+    GETUINT2(ptr+28, flen);
+    GETUINT2(ptr+30, elen);
+    GETUINT2(ptr+32, clen);
+
+    if ((sign != DIRSIGNATURE) || (end - ptr < 46+flen+elen+clen)) break;
+
+    count++;
+    namesiz += flen + 1;
+  }
+
+  /* Index the entries */
+  za->members = (struct ZipMember *)
+                  malloc(sizeof(struct ZipMember) * (size_t) (count + 1));
+  za->names   = (char *) malloc((size_t) (namesiz + 1));
+  if (!za->members || !za->names)
+  {
+    Zarchive_close(za);
+    return NULL;
+  }
+
+  offs = 0;
+  for (ptr = za->buf + cdoff, i=0; i<count; ptr += 46+flen+elen+clen, i++)
+  {
+    struct ZipMember *zm;
+
+    GETUINT2(ptr+28, flen);
+    GETUINT2(ptr+30, elen);
+    GETUINT2(ptr+32, clen);
+
+    /* Leave out directories */
+    if ((flen > 0) && (ptr[46+flen-1] == '/')) continue;
+
+    zm = za->members + za->count++;
+
+    zm->name = za->names + offs;
+    memcpy(zm->name, ptr+46, flen);
+    zm->name[flen] = '\0';
+    offs += flen + 1;
+
+    GETUINT2(ptr+ 8, zm->flag);
+    GETUINT2(ptr+10, zm->comp);
+    GETUINT4(ptr+16, zm->crc3);
+    GETUINT4(ptr+20, zm->csiz);
+    GETUINT4(ptr+24, zm->usiz);
+    GETUINT4(ptr+42, zm->offs);
+  }
+
+  /* Sort them by name, to be found quickly */
+  qsort(za->members, (size_t) za->count, sizeof(struct ZipMember),
+        MemberCompare);
+
+  return za;
+}
+
+long Zmember_size(ZARCHIVE *archive, const char *name)
+{
+  struct ZipMember *zm;
+
+  if (!archive) return -1;
+
+  zm = MemberFind(archive, name);
+  if (!zm) return -1;
+
+  return (long) zm->usiz;
+}
+
+ZFILE *Zopen_member(ZARCHIVE *archive, const char *name, const char *mode)
+{
+  struct ZipioState *zs;
+  struct ZipMember *zm;
+
+  unsigned char *ptr;
+  unsigned long sign, dataoff;
+  unsigned int  flen, elen;
+
+  if (!archive) return NULL;
+
+  zm = MemberFind(archive, name);
+  if (!zm) return NULL;
+
+  /* Only stored or deflated files can be read, and not encrypted ones */
+  if ((zm->flag & 1) || ((zm->comp != 0) && (zm->comp != 8)))
+    return NULL;
+
+  /* Find where its data is from its local file header */
+  if ((zm->offs > archive->len) || (archive->len - zm->offs < 30))
+    return NULL;
+
+  ptr = archive->buf + zm->offs;
+  GETUINT4(ptr   , sign);
+  GETUINT2(ptr+26, flen);
+  GETUINT2(ptr+28, elen);
+
+  dataoff = zm->offs + 30 + flen + elen;
+  if ((sign != ZIPSIGNATURE) || (dataoff > archive->len) ||
+      (zm->csiz > archive->len - dataoff))
+    return NULL;
+
+  /* A stored file is held already, so must fit the Zgetc cache length */
+  if ((zm->comp == 0) && ((zm->csiz != zm->usiz) || (zm->usiz > INT_MAX)))
+    return NULL;
+
+  /* Allocate the ZipioState memory area */
+  zs = StateAllocate();
+  if (!zs) return NULL;
+
+  /* Take the header from the central directory, which has the sizes */
+  zs->sign    = sign;
+  zs->flag    = zm->flag;
+  zs->comp    = zm->comp;
+  zs->crc3    = zm->crc3;
+  zs->csiz    = zm->csiz;
+  zs->usiz    = zm->usiz;
+  zs->flen    = flen;
+  zs->elen    = elen;
+
+  zs->archive = archive;
+  zs->dataoff = (long) dataoff;
+
+  /* The file holds the archive till it is closed */
+  REFINC(archive->refcount);
+
+  /* If it is stored, read it straight from the archive */
+  if (zm->comp == 0)
+  {
+    zs->mapbuf = archive->buf + dataoff;
+    zs->mapped = FALSE;
+    zs->outinf = zs->usiz;
+    zs->getoff = -1;
+    zs->tmpfil = NULL;
+
+    /* Make the Zgetc cache all of the file */
+    zs->cachebase = zs->mapbuf;
+    zs->cachepos  = 0;
+    zs->ptr       = zs->mapbuf;
+    zs->len       = (int) zs->usiz;
+  }
+  /* Otherwise inflate it from the archive, as it is read */
+  else
+  {
+    zs->inpmem    = archive->buf + dataoff;
+    zs->streaming = (strchr(mode, 's') != NULL);
+
+    BufferInitialize(zs, TRUE);
+
+    zs->inflatestate = InflateInitialize(
+                         (void *) zs,
+                         inflate_putbuffer,
+                         inflate_malloc,
+                         inflate_free
+                       );
+  }
+
+  /* Return this state info to the caller */
+  return (ZFILE *) zs;
+}
+
+int Zarchive_close(ZARCHIVE *archive)
+{
+  if (!archive) return -1;
+
+  /* Release it only when no file in it is still open */
+  if (REFDEC(archive->refcount) > 0) return 0;
+
+  if (archive->buf) HoldFree(archive->buf, archive->len, archive->mapped);
+
+  if (archive->members) free(archive->members);
+  if (archive->names)   free(archive->names);
+
+  free(archive);
+
+  return 0;
+}
@@ -45,8 +45,19 @@
  * from the uncompressed file.
  *
  * Note that this library is designed to work for zip files that
- * use the deflate compression method, and to read the first file
- * within the zip archive.
+ * use the deflate compression method, and Zopen() reads the first
+ * file within the zip archive.
+ *
+ * To read any file in an archive of many, open the archive with
+ * Zarchive_open(), which holds all of it in memory (mapped, where
+ * that is possible) and indexes it by name from its central
+ * directory, once.  Zopen_member() then opens a file in it by name,
+ * reading (and inflating) it straight from the archive, and
+ * Zmember_size() gives its size, or -1 if there is no such file.
+ * A name that is not in the archive also matches a file of that
+ * name in a directory in it.  Each file open in an archive holds
+ * it, so Zarchive_close() may be called with files still open: the
+ * archive is released when the last of them is closed.
  *
  * There are a number of tunable parameters in the reference
  * implementation relating to in-memory decompression and the
@@ -64,6 +75,13 @@
  * character read to be re-read.  This is essential when parsing
  * numbers and such.  (1.1.1)
  *
+ * Adding "s" to the mode (as in "rbs") asks for a zip file to be
+ * streamed: it is inflated as it is read, and Zgetc() reads straight
+ * out of the decompressor's window, so nothing is buffered or copied.
+ * This suits reading a file once from the start.  A seek back past
+ * the current window is still allowed, but makes the file start
+ * again from the beginning in the normal, buffered, way.
+ *
  * There are a few stdio routines that aren't represented here, but
  * they can be layered on top of these routines if needed.
  */
@@ -78,6 +96,8 @@ typedef struct {
   unsigned char *ptr;
 } ZFILE;
 
+typedef struct ZipArchive ZARCHIVE;
+
 #define Zgetc(f)                   \
   ((--((f)->len) >= 0)             \
     ? (unsigned char)(*(f)->ptr++) \
@@ -97,6 +117,11 @@ int     Zseek(ZFILE *stream, long offset, int whence);
 long    Ztell(ZFILE *stream);
 int     Zclose(ZFILE *stream);
 
+ZARCHIVE *Zarchive_open(const char *path);
+long      Zmember_size(ZARCHIVE *archive, const char *name);
+ZFILE    *Zopen_member(ZARCHIVE *archive, const char *name, const char *mode);
+int       Zarchive_close(ZARCHIVE *archive);
+
 #ifdef __cplusplus
 }
 #endif